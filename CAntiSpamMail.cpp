@@ -1,29 +1,83 @@
 #include "CAntiSpamMail.h"
 
-CAntiSpamMail::CAntiSpamMail()
+CAntiSpamMail::CAntiSpamMail() : myTokens(myRedis),myCache(NULL),myHot(NULL),myKnown(NULL),myStore(&myTokens),myPool(NULL),myBigrams(false)
 {
 	myRedis = CRedis("127.0.0.1",6379);
 	myRedis.setTimeout(3);
 
-	myFenci = CFenci();
 	myFenci.setDict("/usr/local/etc/dict_chs.utf8.xdb");
 	myFenci.setRule("/usr/local/etc/rules.utf8.ini");
 	myFenci.setCharset("utf-8");
 	myFenci.setIgnoreSign();
 }
 
+CAntiSpamMail::CAntiSpamMail(const CFenci& parent) : myTokens(myRedis),myFenci(parent),myCache(NULL),myHot(NULL),myKnown(NULL),myStore(&myTokens),myPool(NULL),myBigrams(false)
+{
+	myRedis = CRedis("127.0.0.1",6379);
+	myRedis.setTimeout(3);
+}
+
 CAntiSpamMail::~CAntiSpamMail()
 {
+	myRedis.Close();
 }
 
 void CAntiSpamMail::setRedis(const string redisIp,const int redisPort,
 		const int redisTimeout)
 {
+	myRedis.Close();
+	myRedis.setPool(NULL);
+	myPool = NULL;
+	myRedis.setUnixSocket("");
 	myRedis.setIp(redisIp);
 	myRedis.setPort(redisPort);
 	myRedis.setTimeout(redisTimeout);
 }
 
+void CAntiSpamMail::setRedisUnix(const string redisSocket,const int redisTimeout)
+{
+	myRedis.Close();
+	myRedis.setPool(NULL);
+	myPool = NULL;
+	myRedis.setUnixSocket(redisSocket);
+	myRedis.setTimeout(redisTimeout);
+}
+
+/* share already connected contexts with other CAntiSpamMail objects */
+void CAntiSpamMail::setRedisPool(CRedisPool* pool)
+{
+	myRedis.Close();
+	myRedis.setPool(pool);
+	myPool = pool;
+}
+
+void CAntiSpamMail::setTokenCache(CTokenCache* cache)
+{
+	myCache = cache;
+}
+
+void CAntiSpamMail::setHotTokens(CHotTokens* hot)
+{
+	myHot = hot;
+}
+
+void CAntiSpamMail::setKnownTokens(CKnownTokens* known)
+{
+	myKnown = known;
+}
+
+void CAntiSpamMail::setTokenStore(CTokenStore* store)
+{
+	myRedis.Close();
+	myStore = (store != NULL) ? store : &myTokens;
+}
+
+void CAntiSpamMail::setBigrams(const bool bigrams)
+{
+	myBigrams = bigrams;
+	myIntern.setPairs(bigrams);
+}
+
 void CAntiSpamMail::setFenci(const string fenciDict,const string fenciRule,
 		const string fenciCharset)
 {
@@ -32,84 +86,155 @@ void CAntiSpamMail::setFenci(const string fenciDict,const string fenciRule,
 	myFenci.setCharset(fenciCharset);
 }
 
-double CAntiSpamMail::getSpamicity(FastString mailData)
+void CAntiSpamMail::setFastLatin(const bool on)
 {
-    MimeMessage msg(mailData);
-
-    FastString charset="";
-	FastString plain = "";
-	FastString html = "";
-	FastString subject="";
-
-	set<string> result;
-
-	/* parse subject */
-	msg.getSubject(subject,charset);
-	myFenci.getFenciResult(format_to_check(subject.c_str(),charset.c_str()),result);
-
-	/* parse plain */
-    msg.getTextPlain(plain,charset);
-	myFenci.getFenciResult(format_to_check(subject.c_str(),charset.c_str()),result);	
+	myFenci.setFastLatin(on);
+}
 
-	/* parse html */
-	msg.getTextHtml(html,charset);
-	string html_to_check = get_text_from_html(html.c_str());
-	myFenci.getFenciResult(format_to_check(html_to_check,charset.c_str()),result);
+void CAntiSpamMail::setNormalize(const int flags)
+{
+	myFenci.setNormalize(flags);
+}
 
-	/* get wordmap */
-	myRedis.Connect();
+double CAntiSpamMail::getSpamicity(FastString mailData)
+{
+	/* parse subject, plain and html */
+	myIntern.Clear();
+	get_mail_tokens(myFenci,mailData,myIntern);
+	if (myBigrams) add_bigrams(myIntern);
+
+	/* get words, the redis connection is kept open between messages
+	 * unless it is borrowed from a pool */
+	if (myStore == &myTokens && !myRedis.isConnected())
+	{
+		myRedis.Close();
+		myRedis.Connect();
+	}
 
-	map<string,b_word_t> wordmap;
-	getWords(result,wordmap);
+	getWords(myIntern,myWords,myFound);
+	if (myPool != NULL) myRedis.Close();
 
-	myRedis.Close();
+	return getSpamicity(myWords,myFound);
+}
 
-	
+double CAntiSpamMail::getSpamicity(const vector<b_word_t>& words,const vector<bool>& found)
+{
 	/* get fws */
 	vector<double> fws;
-	getFws(wordmap,fws);
+	getFws(words,found,fws);
 
 	return spamicity(fws);
 }
 
-void CAntiSpamMail::getFws(map<string,b_word_t> wordmap,vector<double>& fws)
+void CAntiSpamMail::getFws(const vector<b_word_t>& words,const vector<bool>& found,
+		vector<double>& fws)
 {
 	double goodmsgs = 0.0;
 	double badmsgs = 0.0;
 
-	for (map<string,b_word_t>::iterator it = wordmap.begin(); it != wordmap.end(); ++it)
+	for (size_t i = 0; i < words.size(); ++i)
 	{
-		badmsgs += (it->second).bad;
-		goodmsgs += (it->second).good;
+		if (!found[i]) continue;
+		badmsgs += words[i].bad;
+		goodmsgs += words[i].good;
 	}
 
 	fws.clear();
-	for (map<string,b_word_t>::iterator it = wordmap.begin(); it != wordmap.end(); ++it)
+	fws.reserve(words.size());
+	for (size_t i = 0; i < words.size(); ++i)
 	{
-		fws.push_back(fw((it->second).bad,(it->second).good,badmsgs,goodmsgs));
+		if (found[i]) fws.push_back(fw(words[i].bad,words[i].good,badmsgs,goodmsgs));
 	}
 }
 
-void CAntiSpamMail::getWords(const set<string>& result,map<string,b_word_t>& wordmap)
+/* hot table, bloom filter, cache, then the store; each only sees what
+ * the one before could not decide. words[id] and found[id] follow the token ids. */
+void CAntiSpamMail::getWords(const CTokenIntern& tokens,vector<b_word_t>& words,vector<bool>& found)
 {
-	for (set<string>::iterator it = result.begin(); it != result.end(); ++it)
+	/* a hashed store knows tokens by their hash only, so does everything built from it */
+	if (myStore->isHashed())
 	{
-		string buffer = myRedis.Get(*it);
-		if (buffer != "")
+		myKeys.resize(tokens.getSize());
+		for (uint32_t i = 0; i < tokens.getSize(); ++i)
 		{
-			CDataParse myData(buffer," ");
-			vector<string> ret = myData.getVector();
-			b_word_t wordbuf = {0,0};
-			wordbuf.bad = my_str2int(ret[0]);
-			wordbuf.good = my_str2int(ret[1]);
-			wordmap.insert(pair<string,b_word_t>(*it,wordbuf));
+			myKeys[i] = CTokenKey::hashToken(tokens.getData(i),tokens.getSpan(i).len);
 		}
-		/*
-		else
+	}
+	else
+	{
+		tokens.getTokens(myKeys);
+	}
+	const vector<string>& keys = myKeys;
+
+	b_word_t zero = {0,0};
+	words.assign(keys.size(),zero);
+	found.assign(keys.size(),false);
+
+	vector<size_t> missing;
+	if (myHot != NULL)
+	{
+		tr1::shared_ptr<const CHotTable> hot = myHot->getTable();
+		for (size_t i = 0; i < keys.size(); ++i)
 		{
-			b_word_t wordbuf = {0,0};
-			wordmap.insert(pair<string,b_word_t>(*it,wordbuf));
+			if (hot->Find(keys[i],words[i])) found[i] = true;
+			else missing.push_back(i);
 		}
-		*/
 	}
+	else
+	{
+		for (size_t i = 0; i < keys.size(); ++i) missing.push_back(i);
+	}
+
+	/* obfuscated mail is mostly junk tokens nobody ever fed */
+	if (myKnown != NULL && !missing.empty())
+	{
+		tr1::shared_ptr<const CBloomFilter> known = myKnown->getFilter();
+		vector<size_t> maybe;
+		for (size_t i = 0; i < missing.size(); ++i)
+		{
+			if (known->mayContain(keys[missing[i]])) maybe.push_back(missing[i]);
+		}
+		missing.swap(maybe);
+	}
+
+	if (myCache != NULL && !missing.empty())
+	{
+		vector<string> missKeys;
+		for (size_t i = 0; i < missing.size(); ++i) missKeys.push_back(keys[missing[i]]);
+
+		vector<b_word_t> cachedWords;
+		vector<bool> cachedFound;
+		vector<size_t> stillMissing;
+		myCache->Lookup(missKeys,cachedWords,cachedFound,stillMissing);
+
+		for (size_t i = 0; i < missing.size(); ++i)
+		{
+			words[missing[i]] = cachedWords[i];
+			found[missing[i]] = cachedFound[i];
+		}
+		for (size_t i = 0; i < stillMissing.size(); ++i) stillMissing[i] = missing[stillMissing[i]];
+		missing.swap(stillMissing);
+	}
+
+	if (!missing.empty()) lookupStore(keys,missing,words,found);
+}
+
+/* one batched store lookup for keys[missing[...]], remembered in the cache */
+void CAntiSpamMail::lookupStore(const vector<string>& keys,const vector<size_t>& missing,
+		vector<b_word_t>& words,vector<bool>& found)
+{
+	vector<string> missKeys;
+	for (size_t i = 0; i < missing.size(); ++i) missKeys.push_back(keys[missing[i]]);
+
+	vector<b_word_t> missWords;
+	vector<bool> missFound;
+	bool ok = myStore->Lookup(missKeys,missWords,missFound);
+
+	for (size_t i = 0; i < missing.size(); ++i)
+	{
+		words[missing[i]] = missWords[i];
+		found[missing[i]] = missFound[i];
+	}
+	/* a failed lookup is never cached */
+	if (ok && myCache != NULL) myCache->Store(keys,missing,words,found);
 }
@@ -4,10 +4,17 @@
 #include "mime/MimeMessage.h"
 #include "mime/String.h"
 #include "fenci/CFenci.h"
+#include "fenci/TextScan.h"
 #include "comm/Common.h"
-#include "comm/CDataParse.h"
+#include "comm/TokenRecord.h"
+#include "comm/CTokenCache.h"
+#include "comm/CTokenStore.h"
 #include "bayes/bayes.h"
 #include "CRedis.h"
+#include "CTokenDb.h"
+#include "CHotTokens.h"
+#include "CKnownTokens.h"
+#include "MailText.h"
 #include <map>
 #include <string>
 #include <cstdlib>
@@ -27,31 +34,68 @@
 using namespace std;
 using namespace fast;
 
-typedef struct b_word_t_
-{
-	int bad;
-	int good;
-} b_word_t;
+const double SPAM_CUTOFF = 0.90;
 
 class CAntiSpamMail
 {
 	public:
 		CAntiSpamMail();
+		/* tokenize with a fork of parent, for one CAntiSpamMail per thread */
+		explicit CAntiSpamMail(const CFenci& parent);
 		~CAntiSpamMail();
 
 		void setRedis(const string redisIp,const int redisPort,
 			const int redisTimeout = 3);
+		void setRedisUnix(const string redisSocket,const int redisTimeout = 3);
+		/* borrow a connection from pool for each message and give it back
+		 * when the message is scored, not owned */
+		void setRedisPool(CRedisPool* pool);
+		/* consult cache before redis, not owned, may be shared by threads */
+		void setTokenCache(CTokenCache* cache);
+		/* consult hot tokens before the cache, not owned */
+		void setHotTokens(CHotTokens* hot);
+		/* skip tokens the store's bloom filter has never seen, not owned */
+		void setKnownTokens(CKnownTokens* known);
+		/* look tokens up in store instead of redis, not owned; NULL goes
+		 * back to redis */
+		void setTokenStore(CTokenStore* store);
+		/* score neighbouring token pairs too, for a store fed with them */
+		void setBigrams(const bool bigrams);
 		void setFenci(const string fenciDict,const string fenciRule,
 			const string fenciCharset = "UTF-8");
+		/* CFenci::setFastLatin() and setNormalize(), as the store was fed */
+		void setFastLatin(const bool on);
+		void setNormalize(const int flags);
 
 		double getSpamicity(FastString mailData);
+		/* score already looked up tokens, words[i] counts if found[i] */
+		static double getSpamicity(const vector<b_word_t>& words,const vector<bool>& found);
 		
 	private:
 		CRedis myRedis;
+		CTokenDb myTokens;
 		CFenci myFenci;
+		CTokenCache* myCache;
+		CHotTokens* myHot;
+		CKnownTokens* myKnown;
+		CTokenStore* myStore;
+		CRedisPool* myPool;
+		bool myBigrams;
+
+		/* per message scratch, indexed by token id, kept to reuse the memory */
+		CTokenIntern myIntern;
+		vector<string> myKeys;
+		vector<b_word_t> myWords;
+		vector<bool> myFound;
+
+		CAntiSpamMail(const CAntiSpamMail&);
+		CAntiSpamMail& operator=(const CAntiSpamMail&);
 
-		void getFws(map<string,b_word_t> wordmap,vector<double>& fws);
-		void getWords(const set<string>& result,map<string,b_word_t>& wordmap);
+		static void getFws(const vector<b_word_t>& words,const vector<bool>& found,
+			vector<double>& fws);
+		void getWords(const CTokenIntern& tokens,vector<b_word_t>& words,vector<bool>& found);
+		void lookupStore(const vector<string>& keys,const vector<size_t>& missing,
+			vector<b_word_t>& words,vector<bool>& found);
 };
 
 #endif /*CANTISPAMMAIL_H*/
@@ -0,0 +1,305 @@
+#include "CAsyncScanner.h"
+
+CAsyncScanner::CAsyncScanner() : myTokens(myRedis)
+{
+	myRedis = CRedis("127.0.0.1",6379);
+	myRedis.setTimeout(3);
+	myAsync.setIp("127.0.0.1");
+	myAsync.setPort(6379);
+	myAsync.setTimeout(3);
+
+	myFenci.setDict("/usr/local/etc/dict_chs.utf8.xdb");
+	myFenci.setRule("/usr/local/etc/rules.utf8.ini");
+	myFenci.setCharset("utf-8");
+	myFenci.setIgnoreSign();
+
+	myCache = NULL;
+	myHot = NULL;
+	myKnown = NULL;
+	myBigrams = false;
+	inflight = 0;
+}
+
+CAsyncScanner::~CAsyncScanner()
+{
+	/* runs the callbacks of what is still pending with a NULL reply */
+	myAsync.Close();
+	myRedis.Close();
+}
+
+void CAsyncScanner::setRedis(const string redisIp,const int redisPort,const int redisTimeout)
+{
+	myRedis.Close();
+	myRedis.setUnixSocket("");
+	myRedis.setIp(redisIp);
+	myRedis.setPort(redisPort);
+	myRedis.setTimeout(redisTimeout);
+
+	myAsync.Close();
+	myAsync.setUnixSocket("");
+	myAsync.setIp(redisIp);
+	myAsync.setPort(redisPort);
+	myAsync.setTimeout(redisTimeout);
+}
+
+void CAsyncScanner::setRedisUnix(const string redisSocket,const int redisTimeout)
+{
+	myRedis.Close();
+	myRedis.setUnixSocket(redisSocket);
+	myRedis.setTimeout(redisTimeout);
+
+	myAsync.Close();
+	myAsync.setUnixSocket(redisSocket);
+	myAsync.setTimeout(redisTimeout);
+}
+
+void CAsyncScanner::setFenci(const string fenciDict,const string fenciRule,
+		const string fenciCharset)
+{
+	myFenci.setDict(fenciDict);
+	myFenci.setRule(fenciRule);
+	myFenci.setCharset(fenciCharset);
+}
+
+void CAsyncScanner::setFastLatin(const bool on)
+{
+	myFenci.setFastLatin(on);
+}
+
+void CAsyncScanner::setNormalize(const int flags)
+{
+	myFenci.setNormalize(flags);
+}
+
+void CAsyncScanner::setTokenCache(CTokenCache* cache)
+{
+	myCache = cache;
+}
+
+void CAsyncScanner::setHotTokens(CHotTokens* hot)
+{
+	myHot = hot;
+}
+
+void CAsyncScanner::setKnownTokens(CKnownTokens* known)
+{
+	myKnown = known;
+}
+
+void CAsyncScanner::setBigrams(const bool bigrams)
+{
+	myBigrams = bigrams;
+	myIntern.setPairs(bigrams);
+}
+
+bool CAsyncScanner::Start()
+{
+	/* the layout decides the lookup commands, read it once up front */
+	if (false == myRedis.Connect() || false == myTokens.loadLayout())
+	{
+		errorMsg = myRedis.isConnected() ? myTokens.getError() : myRedis.getError();
+		return false;
+	}
+	myRedis.Close();
+
+	if (false == myAsync.Connect())
+	{
+		errorMsg = myAsync.getError();
+		return false;
+	}
+
+	return true;
+}
+
+bool CAsyncScanner::Submit(FastString& mailData,void* tag)
+{
+	if (!myAsync.isConnected())
+	{
+		myAsync.Close();
+		if (false == myAsync.Connect())
+		{
+			errorMsg = myAsync.getError();
+			return false;
+		}
+	}
+
+	message_t* msg = new message_t;
+	msg->tag = tag;
+	msg->pending = 0;
+	msg->submitted = false;
+	++inflight;
+
+	MimeMessage mime(mailData);
+	for (int part = 0; part < MAIL_PARTS; ++part)
+	{
+		myIntern.Clear();
+		get_part_tokens(myFenci,mime,part,myIntern);
+		/* a part is interned on its own, so pairs never span two parts */
+		if (myBigrams) add_bigrams(myIntern);
+		sendLookups(msg,myIntern);
+
+		/* put this part on the wire before working on the next one */
+		myAsync.Flush();
+		myAsync.Poll(0);
+	}
+
+	msg->submitted = true;
+	if (msg->pending == 0) finish(msg);
+
+	return true;
+}
+
+/* lookups for the tokens of result that are not on the way yet, in the
+ * order of CAntiSpamMail::getWords() */
+bool CAsyncScanner::sendLookups(message_t* msg,const CTokenIntern& result)
+{
+	tr1::shared_ptr<const CHotTable> hot;
+	if (myHot != NULL) hot = myHot->getTable();
+	tr1::shared_ptr<const CBloomFilter> known;
+	if (myKnown != NULL) known = myKnown->getFilter();
+
+	/* a hashed store knows tokens by their hash only, so does everything built from it */
+	bool hashed = myTokens.getKeys().isHashed();
+	b_word_t word = {0,0};
+	vector<string> fresh;
+	for (uint32_t id = 0; id < result.getSize(); ++id)
+	{
+		string key = hashed ? CTokenKey::hashToken(result.getData(id),result.getSpan(id).len) : result.getToken(id);
+		if (!msg->sent.insert(key).second) continue;
+		if (hot && hot->Find(key,word))
+		{
+			msg->tokens.push_back(key);
+			msg->words.push_back(word);
+			msg->found.push_back(true);
+			continue;
+		}
+		if (known && !known->mayContain(key)) continue;
+		fresh.push_back(key);
+	}
+
+	/* cached tokens are known right away, only the rest goes out */
+	vector<b_word_t> cachedWords;
+	vector<bool> cachedFound;
+	if (myCache != NULL)
+	{
+		vector<size_t> missing;
+		myCache->Lookup(fresh,cachedWords,cachedFound,missing);
+
+		vector<string> rest;
+		size_t m = 0;
+		for (size_t i = 0; i < fresh.size(); ++i)
+		{
+			if (m < missing.size() && missing[m] == i)
+			{
+				++m;
+				rest.push_back(fresh[i]);
+			}
+			else if (cachedFound[i])
+			{
+				msg->tokens.push_back(fresh[i]);
+				msg->words.push_back(cachedWords[i]);
+				msg->found.push_back(true);
+			}
+		}
+		fresh.swap(rest);
+	}
+	if (fresh.empty()) return true;
+
+	size_t base = msg->tokens.size();
+	b_word_t zero = {0,0};
+	msg->tokens.insert(msg->tokens.end(),fresh.begin(),fresh.end());
+	msg->words.resize(msg->tokens.size(),zero);
+	msg->found.resize(msg->tokens.size(),false);
+
+	vector<vector<string> > commands;
+	vector<vector<size_t> > slots;
+	myTokens.buildLookup(fresh,commands,slots);
+
+	bool ok = true;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		lookup_t* lookup = new lookup_t;
+		lookup->self = this;
+		lookup->msg = msg;
+		lookup->slots = slots[i];
+		for (size_t j = 0; j < lookup->slots.size(); ++j) lookup->slots[j] += base;
+
+		if (false == myAsync.Command(commands[i],onReply,lookup))
+		{
+			errorMsg = myAsync.getError();
+			delete lookup;
+			ok = false;
+			continue;
+		}
+		++msg->pending;
+	}
+
+	return ok;
+}
+
+void CAsyncScanner::onReply(redisReply* reply,void* privdata)
+{
+	lookup_t* lookup = (lookup_t*)privdata;
+	CAsyncScanner* self = lookup->self;
+	message_t* msg = lookup->msg;
+
+	/* a lost connection scores the message with the tokens it got */
+	if (reply != NULL && reply->type == REDIS_REPLY_ARRAY)
+	{
+		vector<string> values(reply->elements);
+		for (size_t i = 0; i < reply->elements; ++i)
+		{
+			redisReply* r = reply->element[i];
+			if (r->type == REDIS_REPLY_STRING) values[i].assign(r->str,r->len);
+		}
+		self->myTokens.parseLookup(values,lookup->slots,msg->words,msg->found);
+		if (self->myCache != NULL) self->myCache->Store(msg->tokens,lookup->slots,msg->words,msg->found);
+	}
+	else
+	{
+		self->errorMsg = reply ? string("unexpected lookup reply") : self->myAsync.getError();
+	}
+	delete lookup;
+
+	if (--msg->pending == 0 && msg->submitted) self->finish(msg);
+}
+
+void CAsyncScanner::finish(message_t* msg)
+{
+	done.push_back(make_pair(msg->tag,CAntiSpamMail::getSpamicity(msg->words,msg->found)));
+	--inflight;
+	delete msg;
+}
+
+bool CAsyncScanner::Next(void*& tag,double& spamicity,const int timeoutMs)
+{
+	myAsync.Flush();
+	do
+	{
+		if (!done.empty() || inflight == 0) break;
+		if (!myAsync.Poll(timeoutMs))
+		{
+			/* connection gone or timed out, Close() fails what is still pending */
+			myAsync.Close();
+			break;
+		}
+	} while (timeoutMs < 0);
+
+	if (done.empty()) return false;
+
+	tag = done.front().first;
+	spamicity = done.front().second;
+	done.pop_front();
+
+	return true;
+}
+
+size_t CAsyncScanner::getInflight()
+{
+	return inflight;
+}
+
+string CAsyncScanner::getError()
+{
+	return errorMsg;
+}
@@ -0,0 +1,105 @@
+#ifndef CASYNCSCANNER_H
+#define CASYNCSCANNER_H
+
+#include "CAntiSpamMail.h"
+#include "CRedisAsync.h"
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * single threaded scorer that overlaps tokenizing with redis round trips.
+ * The lookups of a part go out as soon as it is tokenized, so the subject
+ * is on the wire while the html part is still being converted, and the
+ * replies of earlier messages are taken in between. Any number of
+ * messages can be in flight; results come back in completion order.
+ * Tokens are looked up like CAntiSpamMail does (hot table, bloom filter,
+ * cache, then redis); there is no CTokenStore, only redis has round trips
+ * worth overlapping.
+ *
+ *	CAsyncScanner scanner;
+ *	scanner.Start();
+ *	scanner.Submit(mail,tag);
+ *	while (scanner.Next(tag,spamicity)) ...
+ */
+class CAsyncScanner
+{
+	public:
+		CAsyncScanner();
+		~CAsyncScanner();
+
+		/* before Start() */
+		void setRedis(const string redisIp,const int redisPort,const int redisTimeout = 3);
+		void setRedisUnix(const string redisSocket,const int redisTimeout = 3);
+		void setFenci(const string fenciDict,const string fenciRule,
+			const string fenciCharset = "UTF-8");
+		/* CFenci::setFastLatin() and setNormalize(), as the store was fed */
+		void setFastLatin(const bool on);
+		void setNormalize(const int flags);
+		/* consult cache before redis, not owned */
+		void setTokenCache(CTokenCache* cache);
+		/* consult hot tokens before the cache, not owned */
+		void setHotTokens(CHotTokens* hot);
+		/* skip tokens the store's bloom filter has never seen, not owned */
+		void setKnownTokens(CKnownTokens* known);
+		/* score neighbouring token pairs too, for a store fed with them */
+		void setBigrams(const bool bigrams);
+
+		/* reads the store layout and opens the async connection */
+		bool Start();
+		/* tokenize mailData and send its lookups, tag comes back from Next() */
+		bool Submit(FastString& mailData,void* tag);
+		/* a finished message, false if none finished within timeoutMs
+		 * (-1: wait as long as messages are in flight) */
+		bool Next(void*& tag,double& spamicity,const int timeoutMs = -1);
+		size_t getInflight();
+
+		string getError();
+
+	private:
+		CAsyncScanner(const CAsyncScanner&);
+		CAsyncScanner& operator=(const CAsyncScanner&);
+
+		typedef struct message_t_
+		{
+			void* tag;
+			set<string> sent;
+			vector<string> tokens;
+			vector<b_word_t> words;
+			vector<bool> found;
+			size_t pending;
+			bool submitted;
+		} message_t;
+
+		typedef struct lookup_t_
+		{
+			CAsyncScanner* self;
+			message_t* msg;
+			vector<size_t> slots;
+		} lookup_t;
+
+		static void onReply(redisReply* reply,void* privdata);
+		bool sendLookups(message_t* msg,const CTokenIntern& result);
+		void finish(message_t* msg);
+
+		CRedis myRedis;
+		CTokenDb myTokens;
+		CRedisAsync myAsync;
+		CFenci myFenci;
+		/* tokens of the part being submitted */
+		CTokenIntern myIntern;
+		CTokenCache* myCache;
+		CHotTokens* myHot;
+		CKnownTokens* myKnown;
+		bool myBigrams;
+
+		size_t inflight;
+		deque<pair<void*,double> > done;
+		string errorMsg;
+};
+
+#endif /*CASYNCSCANNER_H*/
@@ -0,0 +1,152 @@
+#include "CHotTokens.h"
+#include "comm/CTokenFile.h"
+
+#include <functional>
+#include <queue>
+
+CHotTokens::CHotTokens(const size_t tokens_) : tokens(tokens_)
+{
+	redisIp = "127.0.0.1";
+	redisPort = 6379;
+	redisSocket = "";
+	redisTimeout = 3;
+
+	table = tr1::shared_ptr<const CHotTable>(new CHotTable(vector<string>(),vector<b_word_t>()));
+}
+
+CHotTokens::~CHotTokens()
+{
+	Stop();
+}
+
+void CHotTokens::setRedis(const string redisIp_,const int redisPort_,const int redisTimeout_)
+{
+	redisIp = redisIp_;
+	redisPort = redisPort_;
+	redisSocket = "";
+	redisTimeout = redisTimeout_;
+}
+
+void CHotTokens::setRedisUnix(const string redisSocket_,const int redisTimeout_)
+{
+	redisSocket = redisSocket_;
+	redisTimeout = redisTimeout_;
+}
+
+typedef pair<long long,pair<string,b_word_t> > ranked_t;
+
+/* orders by count only, b_word_t has no operator< */
+struct ranked_greater
+{
+	bool operator()(const ranked_t& a,const ranked_t& b) const
+	{
+		return a.first > b.first;
+	}
+};
+
+bool CHotTokens::Load()
+{
+	if (snapshotReader) return loadSnapshot();
+
+	/* a connection of its own, Load() may run on the refresh thread */
+	CRedis myRedis(redisIp,redisPort);
+	myRedis.setTimeout(redisTimeout);
+	if (redisSocket != "") myRedis.setUnixSocket(redisSocket);
+
+	string error;
+	CTokenDb myTokens(myRedis);
+	if (false == myRedis.Connect()) error = myRedis.getError();
+
+	/* min-heap of the top tokens seen so far */
+	priority_queue<ranked_t,vector<ranked_t>,ranked_greater> top;
+	string cursor = "0";
+	vector<string> keys;
+	vector<b_word_t> words;
+	while (error == "")
+	{
+		if (false == myTokens.Scan(cursor,keys,words))
+		{
+			error = myTokens.getError();
+			break;
+		}
+
+		for (size_t i = 0; i < keys.size() && tokens > 0; ++i)
+		{
+			long long count = (long long)words[i].bad + words[i].good;
+			if (top.size() >= tokens && count <= top.top().first) continue;
+
+			top.push(make_pair(count,make_pair(keys[i],words[i])));
+			if (top.size() > tokens) top.pop();
+		}
+
+		if (cursor == "0") break;
+	}
+	myRedis.Close();
+
+	if (error != "")
+	{
+		setError(error);
+		return false;
+	}
+
+	keys.clear();
+	words.clear();
+	for (; !top.empty(); top.pop())
+	{
+		keys.push_back(top.top().second.first);
+		words.push_back(top.top().second.second);
+	}
+	tr1::shared_ptr<const CHotTable> fresh(new CHotTable(keys,words));
+
+	pthread_mutex_lock(&lock);
+	table.swap(fresh);
+	pthread_mutex_unlock(&lock);
+
+	/* readers take it from here */
+	if (snapshotPath != "" && false == CTokenFile::Write(snapshotPath,keys,words,false,error))
+	{
+		setError(error);
+		return false;
+	}
+
+	return true;
+}
+
+bool CHotTokens::loadSnapshot()
+{
+	string version = getSnapshotVersion();
+	if (version == "")
+	{
+		setError(snapshotPath + ": no hot token snapshot");
+		return false;
+	}
+	if (version == snapshotLoaded) return true;
+
+	CTokenFile file;
+	if (false == file.Open(snapshotPath))
+	{
+		setError(file.getError());
+		return false;
+	}
+	vector<string> keys;
+	vector<b_word_t> words;
+	file.getAll(keys,words);
+	file.Close();
+	tr1::shared_ptr<const CHotTable> fresh(new CHotTable(keys,words));
+
+	pthread_mutex_lock(&lock);
+	table.swap(fresh);
+	pthread_mutex_unlock(&lock);
+	snapshotLoaded = version;
+
+	return true;
+}
+
+tr1::shared_ptr<const CHotTable> CHotTokens::getTable()
+{
+	pthread_mutex_lock(&lock);
+	tr1::shared_ptr<const CHotTable> ret = table;
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
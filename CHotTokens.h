@@ -0,0 +1,58 @@
+#ifndef CHOTTOKENS_H
+#define CHOTTOKENS_H
+
+#include "comm/CHotTable.h"
+#include "comm/CRefresher.h"
+#include "CRedis.h"
+#include "CTokenDb.h"
+
+#include <string>
+#include <tr1/memory>
+
+using namespace std;
+
+/*
+ * the top N tokens of the store by bad+good, in a CHotTable that scanners
+ * consult before anything else. Load() scans the whole store once; Start()
+ * repeats that on a background thread and swaps the new table in, readers
+ * keep the table they got until they drop it. Processes that share a
+ * store should scan it once: one builds with setSnapshot(path,false),
+ * the rest read its CTokenFile snapshot with setSnapshot(path,true).
+ *
+ *	CHotTokens hot(10000);
+ *	hot.Load();
+ *	hot.Start(600);
+ *	myAntispam.setHotTokens(&hot);
+ */
+class CHotTokens : public CRefresher
+{
+	public:
+		CHotTokens(const size_t tokens = 10000);
+		virtual ~CHotTokens();
+
+		void setRedis(const string redisIp,const int redisPort,const int redisTimeout = 3);
+		void setRedisUnix(const string redisSocket,const int redisTimeout = 3);
+
+		/* build a table from the store now and swap it in; a snapshot
+		 * reader loads the snapshot instead if it was replaced */
+		virtual bool Load();
+
+		/* never NULL, empty until the first Load() */
+		tr1::shared_ptr<const CHotTable> getTable();
+
+	private:
+		CHotTokens(const CHotTokens&);
+		CHotTokens& operator=(const CHotTokens&);
+
+		bool loadSnapshot();
+
+		size_t tokens;
+		string redisIp;
+		int redisPort;
+		string redisSocket;
+		int redisTimeout;
+
+		tr1::shared_ptr<const CHotTable> table;
+};
+
+#endif /*CHOTTOKENS_H*/
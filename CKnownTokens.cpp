@@ -0,0 +1,157 @@
+#include "CKnownTokens.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+CKnownTokens::CKnownTokens()
+{
+	redisIp = "127.0.0.1";
+	redisPort = 6379;
+	redisSocket = "";
+	redisTimeout = 3;
+
+	filter = tr1::shared_ptr<const CBloomFilter>(new CBloomFilter());
+}
+
+CKnownTokens::~CKnownTokens()
+{
+	Stop();
+}
+
+void CKnownTokens::setRedis(const string redisIp_,const int redisPort_,const int redisTimeout_)
+{
+	redisIp = redisIp_;
+	redisPort = redisPort_;
+	redisSocket = "";
+	redisTimeout = redisTimeout_;
+}
+
+void CKnownTokens::setRedisUnix(const string redisSocket_,const int redisTimeout_)
+{
+	redisSocket = redisSocket_;
+	redisTimeout = redisTimeout_;
+}
+
+/* written to path.tmp and renamed, like CTokenFile::Write() */
+static bool write_snapshot(const string& path,const string& params,const string& bitmap,string& error)
+{
+	string tmp = path + ".tmp";
+	FILE* fp = fopen(tmp.c_str(),"wb");
+	if (fp == NULL)
+	{
+		error = tmp + ": " + strerror(errno);
+		return false;
+	}
+
+	bool ok = params.empty() || fwrite(params.data(),params.size(),1,fp) == 1;
+	ok = fputc('\n',fp) != EOF && ok;
+	ok = (bitmap.empty() || fwrite(bitmap.data(),bitmap.size(),1,fp) == 1) && ok;
+	ok = (fclose(fp) == 0) && ok;
+
+	if (!ok || rename(tmp.c_str(),path.c_str()) != 0)
+	{
+		error = path + ": " + strerror(errno);
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool CKnownTokens::Load()
+{
+	if (snapshotReader) return loadSnapshot();
+
+	/* a connection of its own, Load() may run on the refresh thread */
+	CRedis myRedis(redisIp,redisPort);
+	myRedis.setTimeout(redisTimeout);
+	if (redisSocket != "") myRedis.setUnixSocket(redisSocket);
+
+	/* both in one MGET, so bits and parameters belong together */
+	vector<string> args;
+	args.push_back("MGET");
+	args.push_back(BLOOM_PARAMS_KEY);
+	args.push_back(BLOOM_KEY);
+
+	vector<string> values;
+	if (false == myRedis.Connect() || false == myRedis.Append(args)
+		|| false == myRedis.GetReply(values) || values.size() != 2)
+	{
+		setError(myRedis.getError());
+		return false;
+	}
+	myRedis.Close();
+
+	if (false == setFilter(values[0],values[1])) return false;
+
+	/* readers take it from here */
+	string error;
+	if (snapshotPath != "" && false == write_snapshot(snapshotPath,values[0],values[1],error))
+	{
+		setError(error);
+		return false;
+	}
+
+	return true;
+}
+
+bool CKnownTokens::loadSnapshot()
+{
+	string version = getSnapshotVersion();
+	if (version == "")
+	{
+		setError(snapshotPath + ": no bloom filter snapshot");
+		return false;
+	}
+	if (version == snapshotLoaded) return true;
+
+	ifstream in(snapshotPath.c_str(),ios::binary);
+	string params;
+	if (!in || !getline(in,params))
+	{
+		setError(snapshotPath + ": can't read bloom filter snapshot");
+		return false;
+	}
+	stringstream bitmap;
+	bitmap << in.rdbuf();
+
+	if (false == setFilter(params,bitmap.str())) return false;
+	snapshotLoaded = version;
+
+	return true;
+}
+
+/* swap in a filter of params and bitmap as redis has them */
+bool CKnownTokens::setFilter(const string& params,const string& bitmap)
+{
+	CBloomFilter* fresh = new CBloomFilter();
+	if (params != "" && false == fresh->setParams(params))
+	{
+		delete fresh;
+		setError("bad bloom filter parameters: " + params);
+		return false;
+	}
+	fresh->setBitmap(bitmap);
+
+	tr1::shared_ptr<const CBloomFilter> ptr(fresh);
+	pthread_mutex_lock(&lock);
+	filter.swap(ptr);
+	pthread_mutex_unlock(&lock);
+
+	return true;
+}
+
+tr1::shared_ptr<const CBloomFilter> CKnownTokens::getFilter()
+{
+	pthread_mutex_lock(&lock);
+	tr1::shared_ptr<const CBloomFilter> ret = filter;
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
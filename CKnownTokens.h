@@ -0,0 +1,50 @@
+#ifndef CKNOWNTOKENS_H
+#define CKNOWNTOKENS_H
+
+#include "comm/CBloomFilter.h"
+#include "comm/CRefresher.h"
+#include "CRedis.h"
+
+#include <string>
+#include <tr1/memory>
+
+using namespace std;
+
+/*
+ * the store's bloom filter of known tokens (see comm/CBloomFilter.h), so
+ * never seen tokens are dropped before any lookup. Load() reads the
+ * snapshot from redis, Start() reloads it in the background to pick up
+ * what feed added since. A store without a filter lets every token pass.
+ * With setSnapshot() one process downloads the bitmap and the rest read
+ * it from a file ("<params>\n<bitmap>").
+ */
+class CKnownTokens : public CRefresher
+{
+	public:
+		CKnownTokens();
+		virtual ~CKnownTokens();
+
+		void setRedis(const string redisIp,const int redisPort,const int redisTimeout = 3);
+		void setRedisUnix(const string redisSocket,const int redisTimeout = 3);
+
+		virtual bool Load();
+
+		/* never NULL, lets everything pass until the first Load() */
+		tr1::shared_ptr<const CBloomFilter> getFilter();
+
+	private:
+		CKnownTokens(const CKnownTokens&);
+		CKnownTokens& operator=(const CKnownTokens&);
+
+		bool loadSnapshot();
+		bool setFilter(const string& params,const string& bitmap);
+
+		string redisIp;
+		int redisPort;
+		string redisSocket;
+		int redisTimeout;
+
+		tr1::shared_ptr<const CBloomFilter> filter;
+};
+
+#endif /*CKNOWNTOKENS_H*/
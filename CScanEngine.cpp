@@ -0,0 +1,295 @@
+#include "CScanEngine.h"
+
+CScanResult::CScanResult()
+{
+	pthread_mutex_init(&lock,NULL);
+	pthread_cond_init(&cond,NULL);
+	ready = false;
+	spamicity = 0.0;
+}
+
+CScanResult::~CScanResult()
+{
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&lock);
+}
+
+void CScanResult::set(const double spamicity_)
+{
+	pthread_mutex_lock(&lock);
+	spamicity = spamicity_;
+	ready = true;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&lock);
+}
+
+double CScanResult::get()
+{
+	pthread_mutex_lock(&lock);
+	while (!ready) pthread_cond_wait(&cond,&lock);
+	double ret = spamicity;
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
+
+bool CScanResult::isReady()
+{
+	pthread_mutex_lock(&lock);
+	bool ret = ready;
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
+
+CScanFuture::CScanFuture()
+{
+}
+
+CScanFuture::CScanFuture(const tr1::shared_ptr<CScanResult>& result_) : result(result_)
+{
+}
+
+double CScanFuture::get()
+{
+	return result ? result->get() : 0.0;
+}
+
+bool CScanFuture::isReady()
+{
+	return result ? result->isReady() : true;
+}
+
+bool CScanFuture::isValid()
+{
+	return result ? true : false;
+}
+
+CScanEngine::CScanEngine(const int threads_,const size_t queueSize_)
+	: threads(threads_ > 0 ? threads_ : 1),queueSize(queueSize_ > 0 ? queueSize_ : 1)
+{
+	redisIp = "127.0.0.1";
+	redisPort = 6379;
+	redisSocket = "";
+	redisTimeout = 3;
+	fenciDict = "/usr/local/etc/dict_chs.utf8.xdb";
+	fenciRule = "/usr/local/etc/rules.utf8.ini";
+	fenciCharset = "utf-8";
+	fastLatin = false;
+	normFlags = 0;
+
+	tokenCache = NULL;
+	hotTokens = NULL;
+	knownTokens = NULL;
+	tokenStore = NULL;
+	bigrams = false;
+	parentFenci = NULL;
+	redisPool = NULL;
+	running = false;
+	pthread_mutex_init(&lock,NULL);
+	pthread_cond_init(&notEmpty,NULL);
+	pthread_cond_init(&notFull,NULL);
+}
+
+CScanEngine::~CScanEngine()
+{
+	Stop();
+
+	pthread_cond_destroy(&notFull);
+	pthread_cond_destroy(&notEmpty);
+	pthread_mutex_destroy(&lock);
+}
+
+void CScanEngine::setRedis(const string redisIp_,const int redisPort_,const int redisTimeout_)
+{
+	redisIp = redisIp_;
+	redisPort = redisPort_;
+	redisSocket = "";
+	redisTimeout = redisTimeout_;
+}
+
+void CScanEngine::setRedisUnix(const string redisSocket_,const int redisTimeout_)
+{
+	redisSocket = redisSocket_;
+	redisTimeout = redisTimeout_;
+}
+
+void CScanEngine::setFenci(const string fenciDict_,const string fenciRule_,
+		const string fenciCharset_)
+{
+	fenciDict = fenciDict_;
+	fenciRule = fenciRule_;
+	fenciCharset = fenciCharset_;
+}
+
+void CScanEngine::setFastLatin(const bool on)
+{
+	fastLatin = on;
+}
+
+void CScanEngine::setNormalize(const int flags)
+{
+	normFlags = flags;
+}
+
+void CScanEngine::setTokenCache(CTokenCache* cache)
+{
+	tokenCache = cache;
+}
+
+void CScanEngine::setHotTokens(CHotTokens* hot)
+{
+	hotTokens = hot;
+}
+
+void CScanEngine::setKnownTokens(CKnownTokens* known)
+{
+	knownTokens = known;
+}
+
+void CScanEngine::setTokenStore(CTokenStore* store)
+{
+	tokenStore = store;
+}
+
+void CScanEngine::setBigrams(const bool bigrams_)
+{
+	bigrams = bigrams_;
+}
+
+bool CScanEngine::Start()
+{
+	if (running) return true;
+
+	/* workers fork this one, the dict is in memory so they can share it */
+	parentFenci = new CFenci();
+	parentFenci->setDict(fenciDict,true);
+	parentFenci->setRule(fenciRule);
+	parentFenci->setCharset(fenciCharset);
+	parentFenci->setIgnoreSign();
+	parentFenci->setFastLatin(fastLatin);
+	parentFenci->setNormalize(normFlags);
+
+	if (redisSocket != "") redisPool = CRedisPool::unixSocket(redisSocket,threads);
+	else redisPool = new CRedisPool(redisIp,redisPort,threads);
+	redisPool->setTimeout(redisTimeout);
+
+	/* scws_fork() and scws_free() count references to the shared dict
+	 * without a lock, so every fork is made here, one after the other,
+	 * before its thread runs; reserve() keeps &workers[i] valid */
+	running = true;
+	workers.reserve(threads);
+	for (int i = 0; i < threads; ++i)
+	{
+		worker_t worker;
+		worker.engine = this;
+		worker.mail = newMail();
+		workers.push_back(worker);
+		if (pthread_create(&workers.back().tid,NULL,workerMain,&workers.back()) != 0)
+		{
+			delete workers.back().mail;
+			workers.pop_back();
+			break;
+		}
+	}
+
+	if (workers.empty())
+	{
+		running = false;
+		delete parentFenci;
+		parentFenci = NULL;
+		delete redisPool;
+		redisPool = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+CScanFuture CScanEngine::Submit(const string& mailData)
+{
+	job_t job;
+	job.mailData = mailData;
+	job.result = tr1::shared_ptr<CScanResult>(new CScanResult());
+
+	pthread_mutex_lock(&lock);
+	while (running && queue.size() >= queueSize) pthread_cond_wait(&notFull,&lock);
+	if (!running)
+	{
+		pthread_mutex_unlock(&lock);
+		return CScanFuture();
+	}
+	queue.push_back(job);
+	pthread_cond_signal(&notEmpty);
+	pthread_mutex_unlock(&lock);
+
+	return CScanFuture(job.result);
+}
+
+void CScanEngine::Stop()
+{
+	pthread_mutex_lock(&lock);
+	running = false;
+	pthread_cond_broadcast(&notEmpty);
+	pthread_cond_broadcast(&notFull);
+	pthread_mutex_unlock(&lock);
+
+	for (vector<worker_t>::iterator it = workers.begin(); it != workers.end(); ++it)
+	{
+		pthread_join(it->tid,NULL);
+	}
+	/* all joined, the forks go one after the other like they came */
+	for (vector<worker_t>::iterator it = workers.begin(); it != workers.end(); ++it)
+	{
+		delete it->mail;
+	}
+	workers.clear();
+
+	/* after the workers, they give their connections back on delete */
+	delete redisPool;
+	redisPool = NULL;
+	delete parentFenci;
+	parentFenci = NULL;
+}
+
+void* CScanEngine::workerMain(void* arg)
+{
+	worker_t* worker = (worker_t*)arg;
+	worker->engine->work(*worker->mail);
+	return NULL;
+}
+
+CAntiSpamMail* CScanEngine::newMail()
+{
+	CAntiSpamMail* mail = new CAntiSpamMail(*parentFenci);
+	mail->setRedisPool(redisPool);
+	mail->setTokenCache(tokenCache);
+	mail->setHotTokens(hotTokens);
+	mail->setKnownTokens(knownTokens);
+	mail->setTokenStore(tokenStore);
+	mail->setBigrams(bigrams);
+
+	return mail;
+}
+
+void CScanEngine::work(CAntiSpamMail& myAntispam)
+{
+	for (;;)
+	{
+		pthread_mutex_lock(&lock);
+		while (running && queue.empty()) pthread_cond_wait(&notEmpty,&lock);
+		if (queue.empty())
+		{
+			pthread_mutex_unlock(&lock);
+			break;
+		}
+		job_t job;
+		job.mailData.swap(queue.front().mailData);
+		job.result = queue.front().result;
+		queue.pop_front();
+		pthread_cond_signal(&notFull);
+		pthread_mutex_unlock(&lock);
+
+		job.result->set(myAntispam.getSpamicity(FastString(job.mailData.data(),job.mailData.size())));
+	}
+}
@@ -0,0 +1,141 @@
+#ifndef CSCANENGINE_H
+#define CSCANENGINE_H
+
+#include "CAntiSpamMail.h"
+
+#include <pthread.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <tr1/memory>
+
+using namespace std;
+
+/* result slot of one submitted message, filled by a worker */
+class CScanResult
+{
+	public:
+		CScanResult();
+		~CScanResult();
+
+		void set(const double spamicity);
+		double get();
+		bool isReady();
+
+	private:
+		CScanResult(const CScanResult&);
+		CScanResult& operator=(const CScanResult&);
+
+		pthread_mutex_t lock;
+		pthread_cond_t cond;
+		bool ready;
+		double spamicity;
+};
+
+class CScanFuture
+{
+	public:
+		CScanFuture();
+		CScanFuture(const tr1::shared_ptr<CScanResult>& result);
+
+		/* blocks until the message is scored */
+		double get();
+		bool isReady();
+		bool isValid();
+
+	private:
+		tr1::shared_ptr<CScanResult> result;
+};
+
+/*
+ * pool of scoring threads. Every worker owns a CAntiSpamMail with its
+ * own scws fork; redis connections come from a CRedisPool the workers
+ * share and go back after each message. Messages come from a bounded
+ * queue.
+ *
+ *	CScanEngine engine(8);
+ *	engine.Start();
+ *	CScanFuture f = engine.Submit(mail);
+ *	double spamicity = f.get();
+ */
+class CScanEngine
+{
+	public:
+		CScanEngine(const int threads,const size_t queueSize = 1024);
+		~CScanEngine();
+
+		/* before Start() */
+		void setRedis(const string redisIp,const int redisPort,const int redisTimeout = 3);
+		void setRedisUnix(const string redisSocket,const int redisTimeout = 3);
+		void setFenci(const string fenciDict,const string fenciRule,
+			const string fenciCharset = "UTF-8");
+		/* CFenci::setFastLatin() and setNormalize(), as the store was fed */
+		void setFastLatin(const bool on);
+		void setNormalize(const int flags);
+		/* one cache shared by all workers, not owned */
+		void setTokenCache(CTokenCache* cache);
+		void setHotTokens(CHotTokens* hot);
+		void setKnownTokens(CKnownTokens* known);
+		/* instead of a redis connection per worker, must be thread safe */
+		void setTokenStore(CTokenStore* store);
+		void setBigrams(const bool bigrams);
+
+		bool Start();
+		/* blocks while the queue is full, invalid future once stopped */
+		CScanFuture Submit(const string& mailData);
+		/* scores what is queued, then joins the workers */
+		void Stop();
+
+	private:
+		CScanEngine(const CScanEngine&);
+		CScanEngine& operator=(const CScanEngine&);
+
+		typedef struct job_t_
+		{
+			string mailData;
+			tr1::shared_ptr<CScanResult> result;
+		} job_t;
+
+		/* a thread and the CAntiSpamMail it scores with */
+		typedef struct worker_t_
+		{
+			CScanEngine* engine;
+			CAntiSpamMail* mail;
+			pthread_t tid;
+		} worker_t;
+
+		static void* workerMain(void* arg);
+		CAntiSpamMail* newMail();
+		void work(CAntiSpamMail& myAntispam);
+
+		int threads;
+		size_t queueSize;
+
+		string redisIp;
+		int redisPort;
+		string redisSocket;
+		int redisTimeout;
+		string fenciDict;
+		string fenciRule;
+		string fenciCharset;
+		bool fastLatin;
+		int normFlags;
+
+		CTokenCache* tokenCache;
+		CHotTokens* hotTokens;
+		CKnownTokens* knownTokens;
+		CTokenStore* tokenStore;
+		bool bigrams;
+		CFenci* parentFenci;
+		CRedisPool* redisPool;
+		vector<worker_t> workers;
+
+		pthread_mutex_t lock;
+		pthread_cond_t notEmpty;
+		pthread_cond_t notFull;
+		deque<job_t> queue;
+		bool running;
+};
+
+#endif /*CSCANENGINE_H*/
@@ -0,0 +1,630 @@
+#include "CTokenDb.h"
+#include "comm/Common.h"
+
+#include <map>
+#include <stdio.h>
+
+CTokenDb::CTokenDb(CRedis& redis) : myRedis(redis)
+{
+	layoutLoaded = false;
+}
+
+CTokenDb::~CTokenDb()
+{
+}
+
+bool CTokenDb::loadLayout()
+{
+	vector<string> args;
+	args.push_back("MGET");
+	args.push_back(LAYOUT_KEY);
+	args.push_back(BLOOM_PARAMS_KEY);
+
+	vector<string> values;
+	if (!myRedis.Append(args) || !myRedis.GetReply(values) || values.size() != 2)
+	{
+		errorMsg = myRedis.getError();
+		return false;
+	}
+	string layout = values[0];
+
+	/* feeding keeps the filter of a store that has one */
+	myBloom = CBloomFilter();
+	if (values[1] != "" && !myBloom.setParams(values[1]))
+	{
+		errorMsg = "bad bloom filter parameters: " + values[1];
+		return false;
+	}
+
+	if (!myKeys.setLayout(layout))
+	{
+		errorMsg = "unknown store layout: " + layout;
+		return false;
+	}
+
+	layoutLoaded = true;
+	return true;
+}
+
+/* SCAN until the first token key of the string layout, or the end */
+bool CTokenDb::hasStringTokens(bool& found)
+{
+	CTokenKey strings;
+	string cursor = "0";
+	vector<string> keys;
+	found = false;
+	do
+	{
+		if (!myRedis.Scan(cursor,keys))
+		{
+			errorMsg = myRedis.getError();
+			return false;
+		}
+		for (size_t i = 0; i < keys.size() && !found; ++i)
+		{
+			found = strings.isTokenKey(keys[i]);
+		}
+	} while (!found && cursor != "0");
+
+	return true;
+}
+
+bool CTokenDb::initLayout(const unsigned int buckets,const bool hashed)
+{
+	CTokenKey wanted;
+	wanted.setBuckets(buckets);
+	wanted.setHashed(hashed);
+
+	/* a store without a layout keeps one string key per token, another
+	 * layout would never read them again */
+	vector<string> args;
+	args.push_back("EXISTS");
+	args.push_back(LAYOUT_KEY);
+	long long exists = 0;
+	if (!myRedis.Append(args) || !myRedis.GetReply(exists))
+	{
+		errorMsg = myRedis.getError();
+		return false;
+	}
+	if (exists == 0 && (wanted.isBucketed() || wanted.isHashed()))
+	{
+		bool found = false;
+		if (!hasStringTokens(found)) return false;
+		if (found)
+		{
+			errorMsg = wanted.isHashed() ? "store not empty, run migrate -H" : "store not empty, run migrate -B";
+			return false;
+		}
+	}
+
+	args.clear();
+	args.push_back("SETNX");
+	args.push_back(LAYOUT_KEY);
+	args.push_back(wanted.getLayout());
+
+	if (!myRedis.Append(args) || !myRedis.GetReply() || !loadLayout()) 
+	{
+		errorMsg = myRedis.getError();
+		return false;
+	}
+
+	if (myKeys.getBuckets() != buckets || myKeys.isHashed() != hashed)
+	{
+		errorMsg = "store already has layout " + myKeys.getLayout();
+		return false;
+	}
+
+	return true;
+}
+
+const CTokenKey& CTokenDb::getKeys()
+{
+	if (!layoutLoaded) loadLayout();
+
+	return myKeys;
+}
+
+bool CTokenDb::isHashed()
+{
+	return getKeys().isHashed();
+}
+
+/* HSETNX: a hash names one token, the first writer is right */
+bool CTokenDb::addNames(const vector<string>& hashed,const vector<string>& tokens)
+{
+	vector<string> args(4);
+	args[0] = "HSETNX";
+	args[1] = NAMES_KEY;
+
+	bool ok = true;
+	size_t pending = 0;
+	for (size_t i = 0; i < hashed.size() && i < tokens.size(); ++i)
+	{
+		args[2] = hashed[i];
+		args[3] = tokens[i];
+		if (!myRedis.Append(args))
+		{
+			ok = false;
+			break;
+		}
+		++pending;
+	}
+
+	for (size_t i = 0; i < pending; ++i)
+	{
+		if (!myRedis.GetReply()) ok = false;
+	}
+	if (!ok) errorMsg = myRedis.getError();
+
+	return ok;
+}
+
+bool CTokenDb::getNames(const vector<string>& hashed,vector<string>& tokens)
+{
+	tokens.clear();
+	if (hashed.empty()) return true;
+
+	vector<string> args;
+	args.push_back("HMGET");
+	args.push_back(NAMES_KEY);
+	args.insert(args.end(),hashed.begin(),hashed.end());
+
+	if (!myRedis.Append(args) || !myRedis.GetReply(tokens))
+	{
+		errorMsg = myRedis.getError();
+		return false;
+	}
+
+	return true;
+}
+
+string CTokenDb::getError()
+{
+	return errorMsg;
+}
+
+/* tokens per MGET in the string layout */
+#define LOOKUP_BATCH 256
+
+void CTokenDb::buildLookup(const vector<string>& tokens,vector<vector<string> >& commands,
+		vector<vector<size_t> >& slots)
+{
+	commands.clear();
+	slots.clear();
+	if (!layoutLoaded) loadLayout();
+
+	if (!myKeys.isBucketed())
+	{
+		for (size_t begin = 0; begin < tokens.size(); begin += LOOKUP_BATCH)
+		{
+			size_t end = begin + LOOKUP_BATCH < tokens.size() ? begin + LOOKUP_BATCH : tokens.size();
+
+			commands.push_back(vector<string>(1,"MGET"));
+			commands.back().insert(commands.back().end(),tokens.begin() + begin,tokens.begin() + end);
+			slots.push_back(vector<size_t>());
+			for (size_t i = begin; i < end; ++i) slots.back().push_back(i);
+		}
+		return;
+	}
+
+	/* one HMGET per bucket */
+	map<string,vector<size_t> > buckets;
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		buckets[myKeys.key(tokens[i])].push_back(i);
+	}
+
+	for (map<string,vector<size_t> >::iterator it = buckets.begin(); it != buckets.end(); ++it)
+	{
+		vector<string> args;
+		args.push_back("HMGET");
+		args.push_back(it->first);
+		for (vector<size_t>::iterator i = it->second.begin(); i != it->second.end(); ++i)
+		{
+			args.push_back(myKeys.badField(tokens[*i]));
+			args.push_back(myKeys.goodField(tokens[*i]));
+		}
+
+		commands.push_back(args);
+		slots.push_back(it->second);
+	}
+}
+
+void CTokenDb::parseLookup(const vector<string>& values,const vector<size_t>& slots,
+		vector<b_word_t>& words,vector<bool>& found)
+{
+	if (!myKeys.isBucketed())
+	{
+		for (size_t j = 0; j < slots.size() && j < values.size(); ++j)
+		{
+			found[slots[j]] = decode_record(values[j],words[slots[j]]);
+		}
+		return;
+	}
+
+	for (size_t j = 0; j < slots.size() && 2 * j + 1 < values.size(); ++j)
+	{
+		size_t i = slots[j];
+		if (values[2 * j] == "" && values[2 * j + 1] == "") continue;
+
+		words[i].bad = atoi(values[2 * j].c_str());
+		words[i].good = atoi(values[2 * j + 1].c_str());
+		found[i] = true;
+	}
+}
+
+/* all lookup commands pipelined: one round trip */
+bool CTokenDb::Lookup(const vector<string>& tokens,vector<b_word_t>& words,vector<bool>& found)
+{
+	b_word_t zero = {0,0};
+	words.assign(tokens.size(),zero);
+	found.assign(tokens.size(),false);
+
+	if (!layoutLoaded && !loadLayout()) return false;
+
+	vector<vector<string> > commands;
+	vector<vector<size_t> > slots;
+	buildLookup(tokens,commands,slots);
+
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (!myRedis.Append(commands[i]))
+		{
+			errorMsg = myRedis.getError();
+			return false;
+		}
+	}
+
+	bool ok = true;
+	vector<string> values;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (!myRedis.GetReply(values))
+		{
+			errorMsg = myRedis.getError();
+			ok = false;
+			continue;
+		}
+		parseLookup(values,slots[i],words,found);
+	}
+
+	return ok;
+}
+
+/* the string layout walks SCAN, the bucketed one a bucket per step */
+bool CTokenDb::Scan(string& cursor,vector<string>& tokens,vector<b_word_t>& words)
+{
+	tokens.clear();
+	words.clear();
+	if (!layoutLoaded && !loadLayout()) return false;
+
+	if (!myKeys.isBucketed())
+	{
+		vector<string> keys;
+		vector<string> values;
+		if (!myRedis.Scan(cursor,keys) || !myRedis.MGet(keys,values))
+		{
+			errorMsg = myRedis.getError();
+			return false;
+		}
+
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			b_word_t word = {0,0};
+			if (!myKeys.isTokenKey(keys[i]) || !decode_record(values[i],word)) continue;
+			tokens.push_back(keys[i]);
+			words.push_back(word);
+		}
+		return true;
+	}
+
+	unsigned int n = (unsigned int)atoi(cursor.c_str());
+	vector<string> args;
+	args.push_back("HGETALL");
+	args.push_back(myKeys.bucket(n));
+
+	vector<string> values;
+	if (!myRedis.Append(args) || !myRedis.GetReply(values))
+	{
+		errorMsg = myRedis.getError();
+		return false;
+	}
+
+	/* fields come as "b<token>" and "g<token>", in any order */
+	map<string,b_word_t> bucket;
+	for (size_t i = 0; i + 1 < values.size(); i += 2)
+	{
+		if (values[i].size() < 2) continue;
+
+		b_word_t zero = {0,0};
+		b_word_t& word = bucket.insert(make_pair(values[i].substr(1),zero)).first->second;
+		if (values[i][0] == 'b') word.bad = atoi(values[i + 1].c_str());
+		else if (values[i][0] == 'g') word.good = atoi(values[i + 1].c_str());
+	}
+
+	for (map<string,b_word_t>::iterator it = bucket.begin(); it != bucket.end(); ++it)
+	{
+		tokens.push_back(it->first);
+		words.push_back(it->second);
+	}
+
+	cursor = (n + 1 < myKeys.getBuckets()) ? my_int2str(n + 1) : "0";
+	return true;
+}
+
+bool CTokenDb::Add(const vector<string>& tokens,const vector<b_word_t>& deltas)
+{
+	if (!layoutLoaded && !loadLayout()) return false;
+
+	bool ok = myKeys.isBucketed() ? addBuckets(tokens,deltas) : addStrings(tokens,deltas);
+
+	return ok && addBloom(tokens,deltas);
+}
+
+/* tokens per BITFIELD command of addBloom() */
+#define BLOOM_BATCH 256
+
+/* pipelined BITFIELD SET u1 for the tokens a positive delta may have
+ * created, one command per BLOOM_BATCH tokens */
+bool CTokenDb::addBloom(const vector<string>& tokens,const vector<b_word_t>& deltas)
+{
+	if (myBloom.isEmpty()) return true;
+
+	vector<string> args;
+	vector<uint64_t> bits;
+	size_t pending = 0;
+	size_t batched = 0;
+	bool ok = true;
+	for (size_t i = 0; i < tokens.size() && i < deltas.size() && ok; ++i)
+	{
+		if (deltas[i].bad < 0 || deltas[i].good < 0) continue;
+
+		if (args.empty())
+		{
+			args.push_back("BITFIELD");
+			args.push_back(BLOOM_KEY);
+		}
+		myBloom.getBits(tokens[i],bits);
+		for (size_t j = 0; j < bits.size(); ++j)
+		{
+			char buffer[32] = {0};
+			snprintf(buffer,sizeof(buffer),"%llu",(unsigned long long)bits[j]);
+			args.push_back("SET");
+			args.push_back("u1");
+			args.push_back(buffer);
+			args.push_back("1");
+		}
+
+		if (++batched < BLOOM_BATCH) continue;
+
+		if (!myRedis.Append(args))
+		{
+			errorMsg = myRedis.getError();
+			ok = false;
+		}
+		else ++pending;
+		args.clear();
+		batched = 0;
+	}
+
+	if (ok && !args.empty())
+	{
+		if (!myRedis.Append(args))
+		{
+			errorMsg = myRedis.getError();
+			ok = false;
+		}
+		else ++pending;
+	}
+
+	for (size_t i = 0; i < pending; ++i)
+	{
+		if (!myRedis.GetReply())
+		{
+			errorMsg = myRedis.getError();
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+/*
+ * KEYS: tokens, ARGV: dbad dgood of every token
+ * read-modify-write of a TokenRecord (v1 or legacy), always writes v1
+ */
+static const char* ADD_STRING_SCRIPT =
+	"local function varint(x)\n"
+	"  local s = ''\n"
+	"  while x >= 128 do s = s .. string.char(x % 128 + 128); x = math.floor(x / 128) end\n"
+	"  return s .. string.char(x)\n"
+	"end\n"
+	"for i = 1, #KEYS do\n"
+	"  local db, dg = tonumber(ARGV[2 * i - 1]), tonumber(ARGV[2 * i])\n"
+	"  local v = redis.call('GET', KEYS[i])\n"
+	"  local bad, good = 0, 0\n"
+	"  if v and string.byte(v, 1) == 1 then\n"
+	"    local pos, n = 2, {0, 0}\n"
+	"    for j = 1, 2 do\n"
+	"      local mul = 1\n"
+	"      repeat\n"
+	"        local b = string.byte(v, pos) or 0\n"
+	"        pos = pos + 1\n"
+	"        n[j] = n[j] + (b % 128) * mul\n"
+	"        mul = mul * 128\n"
+	"      until b < 128\n"
+	"    end\n"
+	"    bad, good = n[1], n[2]\n"
+	"  elseif v then\n"
+	"    local b, g = string.match(v, '^(%d+) +(%d+)')\n"
+	"    bad, good = tonumber(b) or 0, tonumber(g) or 0\n"
+	"  end\n"
+	"  if v or (db >= 0 and dg >= 0) then\n"
+	"    bad, good = math.max(bad + db, 0), math.max(good + dg, 0)\n"
+	"    redis.call('SET', KEYS[i], string.char(1) .. varint(bad) .. varint(good))\n"
+	"  end\n"
+	"end\n"
+	"return 0\n";
+
+/*
+ * KEYS: bucket of every token, ARGV: bad field, good field, dbad, dgood
+ * of every token. clamped update of tokens that exist
+ */
+static const char* UNFEED_BUCKET_SCRIPT =
+	"for i = 1, #KEYS do\n"
+	"  local bf, gf = ARGV[4 * i - 3], ARGV[4 * i - 2]\n"
+	"  local db, dg = tonumber(ARGV[4 * i - 1]), tonumber(ARGV[4 * i])\n"
+	"  local v = redis.call('HMGET', KEYS[i], bf, gf)\n"
+	"  if v[1] or v[2] then\n"
+	"    if db ~= 0 then redis.call('HSET', KEYS[i], bf, math.max((tonumber(v[1]) or 0) + db, 0)) end\n"
+	"    if dg ~= 0 then redis.call('HSET', KEYS[i], gf, math.max((tonumber(v[2]) or 0) + dg, 0)) end\n"
+	"  end\n"
+	"end\n"
+	"return 0\n";
+
+/* tokens per EVALSHA */
+#define SCRIPT_BATCH 256
+
+/*
+ * pipeline calls[i] = {"EVALSHA", <sha>, numkeys, ...}. The script is
+ * loaded on first use and reloaded once if the server lost it.
+ */
+bool CTokenDb::evalScript(const char* script,string& sha,vector<vector<string> >& calls)
+{
+	for (int attempt = 0; attempt < 2 && !calls.empty(); ++attempt)
+	{
+		if (sha == "")
+		{
+			vector<string> args;
+			args.push_back("SCRIPT");
+			args.push_back("LOAD");
+			args.push_back(script);
+			if (!myRedis.Append(args) || !myRedis.GetReply(sha))
+			{
+				errorMsg = myRedis.getError();
+				return false;
+			}
+		}
+
+		for (size_t i = 0; i < calls.size(); ++i)
+		{
+			calls[i][1] = sha;
+			if (!myRedis.Append(calls[i]))
+			{
+				errorMsg = myRedis.getError();
+				return false;
+			}
+		}
+
+		bool ok = true;
+		vector<vector<string> > retry;
+		for (size_t i = 0; i < calls.size(); ++i)
+		{
+			if (myRedis.GetReply()) continue;
+
+			errorMsg = myRedis.getError();
+			if (errorMsg.compare(0,8,"NOSCRIPT") == 0) retry.push_back(calls[i]);
+			else ok = false;
+		}
+		if (!ok) return false;
+
+		calls.swap(retry);
+		sha = "";
+	}
+
+	return calls.empty();
+}
+
+bool CTokenDb::addStrings(const vector<string>& tokens,const vector<b_word_t>& deltas)
+{
+	vector<vector<string> > calls;
+	for (size_t begin = 0; begin < tokens.size(); begin += SCRIPT_BATCH)
+	{
+		size_t end = begin + SCRIPT_BATCH < tokens.size() ? begin + SCRIPT_BATCH : tokens.size();
+
+		vector<string> args;
+		args.push_back("EVALSHA");
+		args.push_back("");
+		args.push_back(my_int2str(end - begin));
+		args.insert(args.end(),tokens.begin() + begin,tokens.begin() + end);
+		for (size_t i = begin; i < end; ++i)
+		{
+			args.push_back(my_int2str(deltas[i].bad));
+			args.push_back(my_int2str(deltas[i].good));
+		}
+		calls.push_back(args);
+	}
+
+	return evalScript(ADD_STRING_SCRIPT,addStringSha,calls);
+}
+
+/* pipelined HINCRBY to feed, a clamping script for tokens to unfeed */
+bool CTokenDb::addBuckets(const vector<string>& tokens,const vector<b_word_t>& deltas)
+{
+	vector<size_t> unfeed;
+	size_t pending = 0;
+	vector<string> args(4);
+	args[0] = "HINCRBY";
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		if (deltas[i].bad < 0 || deltas[i].good < 0)
+		{
+			unfeed.push_back(i);
+			continue;
+		}
+
+		args[1] = myKeys.key(tokens[i]);
+		for (int which = 0; which < 2; ++which)
+		{
+			int delta = which == 0 ? deltas[i].bad : deltas[i].good;
+			if (delta == 0) continue;
+
+			args[2] = which == 0 ? myKeys.badField(tokens[i]) : myKeys.goodField(tokens[i]);
+			args[3] = my_int2str(delta);
+			if (!myRedis.Append(args))
+			{
+				errorMsg = myRedis.getError();
+				return false;
+			}
+			++pending;
+		}
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < pending; ++i)
+	{
+		long long value = 0;
+		if (!myRedis.GetReply(value))
+		{
+			errorMsg = myRedis.getError();
+			ok = false;
+		}
+	}
+	if (!ok || unfeed.empty()) return ok;
+
+	vector<vector<string> > calls;
+	for (size_t begin = 0; begin < unfeed.size(); begin += SCRIPT_BATCH)
+	{
+		size_t end = begin + SCRIPT_BATCH < unfeed.size() ? begin + SCRIPT_BATCH : unfeed.size();
+
+		args.clear();
+		args.push_back("EVALSHA");
+		args.push_back("");
+		args.push_back(my_int2str(end - begin));
+		for (size_t j = begin; j < end; ++j)
+		{
+			args.push_back(myKeys.key(tokens[unfeed[j]]));
+		}
+		for (size_t j = begin; j < end; ++j)
+		{
+			size_t i = unfeed[j];
+			args.push_back(myKeys.badField(tokens[i]));
+			args.push_back(myKeys.goodField(tokens[i]));
+			args.push_back(my_int2str(deltas[i].bad));
+			args.push_back(my_int2str(deltas[i].good));
+		}
+		calls.push_back(args);
+	}
+
+	return evalScript(UNFEED_BUCKET_SCRIPT,unfeedBucketSha,calls);
+}
@@ -0,0 +1,77 @@
+#ifndef CTOKENDB_H
+#define CTOKENDB_H
+
+#include "comm/TokenRecord.h"
+#include "comm/CTokenKey.h"
+#include "comm/CTokenStore.h"
+#include "comm/CBloomFilter.h"
+#include "CRedis.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * the redis token store: counters on top of a connected CRedis, in
+ * whatever layout the store uses (see CTokenKey). One connection, so one
+ * thread at a time.
+ */
+class CTokenDb : public CTokenStore
+{
+	public:
+		CTokenDb(CRedis& redis);
+		virtual ~CTokenDb();
+
+		using CTokenStore::Add;
+
+		/* read the layout of the store, a store without one uses string keys */
+		bool loadLayout();
+		/* give an empty store a layout, fails if it already has another one
+		 * or holds string keys already: those need migrate */
+		bool initLayout(const unsigned int buckets,const bool hashed = false);
+		const CTokenKey& getKeys();
+		virtual bool isHashed();
+
+		/* the hash -> token side table of a hashed store, for debugging */
+		bool addNames(const vector<string>& hashed,const vector<string>& tokens);
+		/* tokens[i] is "" if hashed[i] has no name */
+		bool getNames(const vector<string>& hashed,vector<string>& tokens);
+
+		/* words[i] is the record of tokens[i], found[i] is false if unknown */
+		virtual bool Lookup(const vector<string>& tokens,vector<b_word_t>& words,vector<bool>& found);
+
+		/* Lookup() in two steps, for callers doing their own I/O: reply
+		 * values of commands[i] fill the tokens listed in slots[i] */
+		void buildLookup(const vector<string>& tokens,vector<vector<string> >& commands,
+			vector<vector<size_t> >& slots);
+		void parseLookup(const vector<string>& values,const vector<size_t>& slots,
+			vector<b_word_t>& words,vector<bool>& found);
+
+		/* walk the whole store, start with cursor "0", done when it is
+		 * "0" again. A step returns some tokens, maybe none */
+		bool Scan(string& cursor,vector<string>& tokens,vector<b_word_t>& words);
+
+		/* atomically on the server and pipelined, then the bits of fed
+		 * tokens are set in the store's bloom filter if it has one */
+		virtual bool Add(const vector<string>& tokens,const vector<b_word_t>& deltas);
+
+		virtual string getError();
+
+	private:
+		CRedis& myRedis;
+		CTokenKey myKeys;
+		CBloomFilter myBloom;
+		bool layoutLoaded;
+		string errorMsg;
+		string addStringSha;
+		string unfeedBucketSha;
+
+		bool hasStringTokens(bool& found);
+		bool addStrings(const vector<string>& tokens,const vector<b_word_t>& deltas);
+		bool addBuckets(const vector<string>& tokens,const vector<b_word_t>& deltas);
+		bool addBloom(const vector<string>& tokens,const vector<b_word_t>& deltas);
+		bool evalScript(const char* script,string& sha,vector<vector<string> >& calls);
+};
+
+#endif /*CTOKENDB_H*/
@@ -0,0 +1,107 @@
+#include "MailText.h"
+
+#include <errno.h>
+#include <iconv.h>
+#include <string.h>
+
+#include "comm/Hash.h"
+
+/* text in charset to utf-8 a piece at a time, each piece goes to the
+ * tokenizer as soon as it is converted (see CFenci::feedText()) */
+static void feed_converted(CFenci& myFenci,const char* text,const char* charset,CTokenIntern& result)
+{
+	iconv_t cd = iconv_open("utf-8",charset);
+	if (cd == (iconv_t)-1) return;
+
+	char out[16 * 1024];
+	char* in = (char*)text;
+	size_t ileft = strlen(text);
+	while (ileft > 0)
+	{
+		char* to = out;
+		size_t oleft = sizeof(out);
+		size_t ret = iconv(cd,&in,&ileft,&to,&oleft);
+		myFenci.feedText(out,to - out,result);
+
+		/* like format_to_check(), text up to a bad sequence counts */
+		if (ret == (size_t)-1 && errno != E2BIG) break;
+	}
+	iconv_close(cd);
+
+	myFenci.finishText(result);
+}
+
+/* every part is streamed, no utf-8 copy of a whole part is made */
+void get_part_tokens(CFenci& myFenci,MimeMessage& msg,const int part,CTokenIntern& result)
+{
+	FastString charset = "";
+	FastString text = "";
+
+	switch (part)
+	{
+		case MAIL_SUBJECT:
+			msg.getSubject(text,charset);
+			feed_converted(myFenci,text.c_str(),charset.c_str(),result);
+			break;
+
+		case MAIL_PLAIN:
+			msg.getTextPlain(text,charset);
+			feed_converted(myFenci,text.c_str(),charset.c_str(),result);
+			break;
+
+		case MAIL_HTML:
+			msg.getTextHtml(text,charset);
+			feed_converted(myFenci,get_text_from_html(text.c_str()).c_str(),charset.c_str(),result);
+			break;
+	}
+}
+
+void get_mail_tokens(CFenci& myFenci,FastString& mailData,CTokenIntern& result)
+{
+	MimeMessage msg(mailData);
+
+	for (int part = 0; part < MAIL_PARTS; ++part)
+	{
+		get_part_tokens(myFenci,msg,part,result);
+		result.Break();
+	}
+}
+
+void get_mail_tokens(CFenci& myFenci,FastString& mailData,set<string>& result)
+{
+	get_mail_tokens(myFenci,mailData,result,false);
+}
+
+/* the same tokens as the CTokenIntern path, collected */
+void get_mail_tokens(CFenci& myFenci,FastString& mailData,set<string>& result,const bool bigrams)
+{
+	CTokenIntern tokens;
+	tokens.setPairs(bigrams);
+	get_mail_tokens(myFenci,mailData,tokens);
+	if (bigrams) add_bigrams(tokens);
+
+	vector<string> all;
+	tokens.getTokens(all);
+	result.insert(all.begin(),all.end());
+}
+
+void add_bigrams(CTokenIntern& result)
+{
+	/* hash every token once, a pair only combines two of them */
+	vector<uint64_t> hashes(result.getSize());
+	for (uint32_t id = 0; id < hashes.size(); ++id)
+	{
+		hashes[id] = hash64(result.getData(id),result.getSpan(id).len);
+	}
+
+	/* the bigrams are no neighbours of anything */
+	result.setPairs(false);
+	const vector<uint64_t>& pairs = result.getPairs();
+	char key[BIGRAM_KEY_SIZE];
+	for (size_t i = 0; i < pairs.size(); ++i)
+	{
+		CTokenKey::bigramKey(hashes[pairs[i] >> 32],hashes[pairs[i] & 0xFFFFFFFF],key);
+		result.Add(key,BIGRAM_KEY_SIZE);
+	}
+	result.setPairs(true);
+}
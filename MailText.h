@@ -0,0 +1,40 @@
+#ifndef MAILTEXT_H
+#define MAILTEXT_H
+
+#include "mime/MimeMessage.h"
+#include "mime/String.h"
+#include "fenci/CFenci.h"
+#include "comm/Common.h"
+#include "comm/CTokenKey.h"
+
+#include <string>
+#include <set>
+
+using namespace std;
+using namespace fast;
+
+/* the parts of a mail that are tokenized, in this order */
+enum
+{
+	MAIL_SUBJECT = 0,
+	MAIL_PLAIN,
+	MAIL_HTML,
+	MAIL_PARTS
+};
+
+/* tokens of one part, converted and tokenized a piece at a time (see
+ * CFenci::feedText()); every tokenizing of a mail goes through here, so
+ * training and scoring see the same tokens */
+void get_part_tokens(CFenci& myFenci,MimeMessage& msg,const int part,CTokenIntern& result);
+
+/* tokens of all parts */
+void get_mail_tokens(CFenci& myFenci,FastString& mailData,set<string>& result);
+void get_mail_tokens(CFenci& myFenci,FastString& mailData,CTokenIntern& result);
+/* with bigrams, the tokens plus one bigram token (see CTokenKey::bigramKey())
+ * for every two neighbouring tokens of a part */
+void get_mail_tokens(CFenci& myFenci,FastString& mailData,set<string>& result,const bool bigrams);
+
+/* the bigram tokens of result's pairs, result must have had pairs on */
+void add_bigrams(CTokenIntern& result);
+
+#endif /*MAILTEXT_H*/
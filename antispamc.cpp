@@ -0,0 +1,95 @@
+#include "comm/Common.h"
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace std;
+
+/* antispamc -- send emails to antispamd and print its verdicts */
+
+const char* DEFAULT_SOCKET = "/tmp/antispamd.sock";
+const unsigned int MAX_RESPONSE_SIZE = 1024;
+
+static int connect_unix(const string path)
+{
+	int fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if (fd < 0) return -1;
+
+	struct sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path,path.c_str(),sizeof(addr.sun_path) - 1);
+
+	if (connect(fd,(struct sockaddr*)&addr,sizeof(addr)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int main(int argc,char* argv[])
+{
+	string sockPath = DEFAULT_SOCKET;
+
+	int opt;
+	while ((opt = getopt(argc,argv,"s:")) != -1)
+	{
+		if (opt == 's') sockPath = optarg;
+		else
+		{
+			cerr << "Usage: " << argv[0] << " [-s socket] <email>..." << endl;
+			exit(-1);
+		}
+	}
+	if (optind >= argc)
+	{
+		cerr << "Usage: " << argv[0] << " [-s socket] <email>..." << endl;
+		exit(-1);
+	}
+
+	int fd = connect_unix(sockPath);
+	if (fd < 0)
+	{
+		cerr << "can't connect to " << sockPath << endl;
+		exit(-1);
+	}
+
+	/* one connection for all emails, one that can't be read is skipped */
+	int ret = 0;
+	for (int i = optind; i < argc; ++i)
+	{
+		ifstream in(argv[i],ios::in | ios::binary);
+		if (!in.is_open())
+		{
+			cerr << "can't open " << argv[i] << endl;
+			ret = -1;
+			continue;
+		}
+		stringstream buffer;
+		buffer << in.rdbuf();
+
+		string response;
+		if (!write_frame(fd,buffer.str()) || !read_frame(fd,response,MAX_RESPONSE_SIZE))
+		{
+			cerr << "antispamd closed the connection" << endl;
+			close(fd);
+			exit(-1);
+		}
+
+		if (argc - optind > 1) cout << response << " " << argv[i] << endl;
+		else cout << response << endl;
+	}
+
+	close(fd);
+	exit(ret);
+}
@@ -0,0 +1,379 @@
+#include "CAntiSpamMail.h"
+#include "comm/CTokenFile.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/*
+ * antispamd -- persistent scoring server
+ *
+ * The master listens on a unix domain socket and prefork workers accept
+ * on it. Every worker owns one CAntiSpamMail, so the scws dictionary, the
+ * redis connection and the token cache stay warm across messages.
+ *
+ * The hot token table and the bloom filter of known tokens are built once:
+ * a builder process scans the store and downloads the bitmap every -R
+ * seconds and writes both next to the socket (<socket>.hot, .bloom).
+ * Workers start with the master's first copy (shared copy-on-write) and
+ * only reload the files when the builder has replaced them. The master
+ * never runs a thread itself, it keeps forking workers and a fork of a
+ * threaded process may inherit a lock some other thread held.
+ *
+ * With -f the workers score from a file written by exportdb and never
+ * talk to redis; the mapping is made before forking and shared.
+ *
+ * -D picks how the scws dictionary is held: "shared" (default) loads it
+ * into memory in the master, workers fork that engine and share the
+ * pages; "mem" loads a copy per worker; "file" reads the xdb on every
+ * lookup. fenci/bench compares them.
+ *
+ * -2 scores pairs of neighbouring tokens too, for a store fed with
+ * feed --bigrams; -L splits latin text without scws and -Z normalizes
+ * it first, for one fed with the same feed -L/-Z.
+ *
+ * protocol (see read_frame/write_frame):
+ *	request:  <4 bytes length, network order><raw email>
+ *	response: <4 bytes length, network order>"SPAM 0.987654" | "HAM 0.012345"
+ * a client may send any number of requests on one connection.
+ */
+
+const char* DEFAULT_SOCKET = "/tmp/antispamd.sock";
+const int DEFAULT_WORKERS = 4;
+const unsigned int MAX_MAIL_SIZE = 64 * 1024 * 1024;
+const size_t DEFAULT_CACHE_SIZE = 100000;
+const int DEFAULT_CACHE_TTL = 300;
+const size_t DEFAULT_HOT_TOKENS = 10000;
+const int DEFAULT_HOT_REFRESH = 600;
+/* how often workers look for a new snapshot, a stat() */
+const int SNAPSHOT_CHECK = 10;
+const char* FENCI_DICT = "/usr/local/etc/dict_chs.utf8.xdb";
+const char* FENCI_RULE = "/usr/local/etc/rules.utf8.ini";
+/* how long a worker blocks on an idle client before it looks at stopping */
+const int STOP_CHECK = 1;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_stop(int)
+{
+	stopping = 1;
+}
+
+/* no SA_RESTART, so a blocking accept/waitpid sees the signal */
+static void set_signal(int sig,void (*handler)(int))
+{
+	struct sigaction sa;
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(sig,&sa,NULL);
+}
+
+static void usage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [-s socket] [-w workers] [-r redis_ip] [-p redis_port] [-u redis_socket]"
+		<< " [-c cache_tokens] [-t cache_ttl] [-H hot_tokens] [-R hot_refresh] [-f token_file]"
+		<< " [-D file|mem|shared] [-2] [-L] [-Z case,width,digits]" << endl;
+	exit(-1);
+}
+
+static int listen_unix(const string path)
+{
+	int fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if (fd < 0) return -1;
+
+	struct sockaddr_un addr;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+	{
+		close(fd);
+		return -1;
+	}
+	strncpy(addr.sun_path,path.c_str(),sizeof(addr.sun_path) - 1);
+
+	unlink(path.c_str());
+	if (bind(fd,(struct sockaddr*)&addr,sizeof(addr)) < 0 || listen(fd,128) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	chmod(path.c_str(),0666);
+
+	return fd;
+}
+
+static void serve_client(int fd,CAntiSpamMail& myAntispam)
+{
+	struct timeval tv;
+	tv.tv_sec = STOP_CHECK;
+	tv.tv_usec = 0;
+	setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+
+	string request;
+	while (!stopping && read_frame(fd,request,MAX_MAIL_SIZE,&stopping))
+	{
+		double spamicity = myAntispam.getSpamicity(FastString(request.data(),request.size()));
+
+		char response[64] = {0};
+		snprintf(response,sizeof(response),"%s %f",
+			(spamicity > SPAM_CUTOFF) ? "SPAM" : "HAM",spamicity);
+
+		if (!write_frame(fd,response)) break;
+	}
+}
+
+static string redisIp = "127.0.0.1";
+static int redisPort = 6379;
+static string redisSocket = "";
+static size_t cacheSize = DEFAULT_CACHE_SIZE;
+static int cacheTtl = DEFAULT_CACHE_TTL;
+static size_t hotSize = DEFAULT_HOT_TOKENS;
+static int hotRefresh = DEFAULT_HOT_REFRESH;
+/* the builder process' builders and the workers' snapshot readers */
+static CHotTokens* hotBuilder = NULL;
+static CKnownTokens* knownBuilder = NULL;
+static CHotTokens* hotTokens = NULL;
+static CKnownTokens* knownTokens = NULL;
+static string tokenPath = "";
+static CTokenFile tokenFile;
+static string dictMode = "shared";
+static bool bigrams = false;
+static bool fastLatin = false;
+static int normFlags = 0;
+static CFenci* parentFenci = NULL;
+
+static CFenci* load_fenci(const bool inMemory)
+{
+	CFenci* fenci = new CFenci();
+	if (false == fenci->setDict(FENCI_DICT,inMemory))
+	{
+		cerr << "can't load dict " << FENCI_DICT << endl;
+		exit(-1);
+	}
+	fenci->setRule(FENCI_RULE);
+	fenci->setCharset("utf-8");
+	fenci->setIgnoreSign();
+
+	return fenci;
+}
+
+static void worker_loop(int listenfd)
+{
+	/* loaded once per worker, reused for every message */
+	if (dictMode == "mem") parentFenci = load_fenci(true);
+	CAntiSpamMail* antispam = (parentFenci != NULL) ? new CAntiSpamMail(*parentFenci) : new CAntiSpamMail();
+	CAntiSpamMail& myAntispam = *antispam;
+	myAntispam.setBigrams(bigrams);
+	myAntispam.setFastLatin(fastLatin);
+	myAntispam.setNormalize(normFlags);
+	if (redisSocket != "") myAntispam.setRedisUnix(redisSocket);
+	else myAntispam.setRedis(redisIp,redisPort);
+
+	/* -c 0 turns the cache off, a token file needs none */
+	CTokenCache cache(cacheSize,cacheTtl);
+	if (cacheSize > 0 && !tokenFile.isOpen()) myAntispam.setTokenCache(&cache);
+
+	if (tokenFile.isOpen()) myAntispam.setTokenStore(&tokenFile);
+
+	/* threads don't survive fork(), start watching the snapshots here */
+	if (hotTokens != NULL)
+	{
+		hotTokens->Start(SNAPSHOT_CHECK);
+		myAntispam.setHotTokens(hotTokens);
+	}
+	if (knownTokens != NULL)
+	{
+		knownTokens->Start(SNAPSHOT_CHECK);
+		myAntispam.setKnownTokens(knownTokens);
+	}
+
+	while (!stopping)
+	{
+		int fd = accept(listenfd,NULL,NULL);
+		if (fd < 0)
+		{
+			if (errno == EINTR) continue;
+			cerr << "accept: " << strerror(errno) << endl;
+			break;
+		}
+
+		serve_client(fd,myAntispam);
+		close(fd);
+	}
+
+	if (hotTokens != NULL) hotTokens->Stop();
+	if (knownTokens != NULL) knownTokens->Stop();
+	delete antispam;
+}
+
+static pid_t spawn_worker(int listenfd)
+{
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		worker_loop(listenfd);
+		exit(0);
+	}
+
+	return pid;
+}
+
+/* the only process with refresh threads, it never forks */
+static void builder_loop()
+{
+	/* one scan of the store per refresh for all workers */
+	if (hotBuilder != NULL) hotBuilder->Start(hotRefresh);
+	if (knownBuilder != NULL) knownBuilder->Start(hotRefresh);
+
+	/* the signal may land on a refresh thread, so look at the flag */
+	while (!stopping) sleep(STOP_CHECK);
+
+	if (hotBuilder != NULL) hotBuilder->Stop();
+	if (knownBuilder != NULL) knownBuilder->Stop();
+}
+
+static pid_t spawn_builder()
+{
+	if (hotBuilder == NULL && knownBuilder == NULL) return 0;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		builder_loop();
+		exit(0);
+	}
+
+	return pid;
+}
+
+int main(int argc,char* argv[])
+{
+	string sockPath = DEFAULT_SOCKET;
+	int workers = DEFAULT_WORKERS;
+
+	int opt;
+	while ((opt = getopt(argc,argv,"s:w:r:p:u:c:t:H:R:f:D:2LZ:")) != -1)
+	{
+		switch (opt)
+		{
+			case 's': sockPath = optarg; break;
+			case 'w': workers = atoi(optarg); break;
+			case 'r': redisIp = optarg; break;
+			case 'p': redisPort = atoi(optarg); break;
+			case 'u': redisSocket = optarg; break;
+			case 'c': cacheSize = strtoul(optarg,NULL,10); break;
+			case 't': cacheTtl = atoi(optarg); break;
+			case 'H': hotSize = strtoul(optarg,NULL,10); break;
+			case 'R': hotRefresh = atoi(optarg); break;
+			case 'f': tokenPath = optarg; break;
+			case 'D': dictMode = optarg; break;
+			case '2': bigrams = true; break;
+			case 'L': fastLatin = true; break;
+			case 'Z': if (false == parse_normalize(optarg,normFlags)) usage(argv[0]); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || workers <= 0) usage(argv[0]);
+	if (dictMode != "file" && dictMode != "mem" && dictMode != "shared") usage(argv[0]);
+
+	int listenfd = listen_unix(sockPath);
+	if (listenfd < 0)
+	{
+		cerr << "can't listen on " << sockPath << ": " << strerror(errno) << endl;
+		exit(-1);
+	}
+
+	if (tokenPath != "" && false == tokenFile.Open(tokenPath))
+	{
+		cerr << tokenFile.getError() << endl;
+		exit(-1);
+	}
+
+	if (dictMode == "shared") parentFenci = load_fenci(true);
+
+	/* -H 0 turns the hot table off */
+	const string hotPath = sockPath + ".hot";
+	if (hotSize > 0 && !tokenFile.isOpen())
+	{
+		hotBuilder = new CHotTokens(hotSize);
+		if (redisSocket != "") hotBuilder->setRedisUnix(redisSocket);
+		else hotBuilder->setRedis(redisIp,redisPort);
+		hotBuilder->setSnapshot(hotPath,false);
+		if (false == hotBuilder->Load())
+		{
+			cerr << "can't load hot tokens: " << hotBuilder->getError() << endl;
+		}
+
+		hotTokens = new CHotTokens(hotSize);
+		hotTokens->setSnapshot(hotPath,true);
+		hotTokens->Load();
+	}
+
+	const string knownPath = sockPath + ".bloom";
+	if (!tokenFile.isOpen())
+	{
+		knownBuilder = new CKnownTokens();
+		if (redisSocket != "") knownBuilder->setRedisUnix(redisSocket);
+		else knownBuilder->setRedis(redisIp,redisPort);
+		knownBuilder->setSnapshot(knownPath,false);
+		if (false == knownBuilder->Load())
+		{
+			cerr << "can't load bloom filter: " << knownBuilder->getError() << endl;
+		}
+
+		knownTokens = new CKnownTokens();
+		knownTokens->setSnapshot(knownPath,true);
+		knownTokens->Load();
+	}
+
+	set_signal(SIGPIPE,SIG_IGN);
+	set_signal(SIGTERM,on_stop);
+	set_signal(SIGINT,on_stop);
+
+	set<pid_t> children;
+	pid_t builder = spawn_builder();
+	if (builder > 0) children.insert(builder);
+	for (int i = 0; i < workers; ++i)
+	{
+		pid_t pid = spawn_worker(listenfd);
+		if (pid > 0) children.insert(pid);
+	}
+
+	/* respawn workers and the builder that die until we are told to stop */
+	while (!stopping)
+	{
+		int status = 0;
+		pid_t pid = waitpid(-1,&status,0);
+		if (pid < 0)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		children.erase(pid);
+		if (!stopping)
+		{
+			sleep(1);
+			if (pid == builder) pid = builder = spawn_builder();
+			else pid = spawn_worker(listenfd);
+			if (pid > 0) children.insert(pid);
+		}
+	}
+
+	for (set<pid_t>::iterator it = children.begin(); it != children.end(); ++it)
+	{
+		kill(*it,SIGTERM);
+	}
+	while (waitpid(-1,NULL,0) > 0 || errno == EINTR);
+
+	unlink(hotPath.c_str());
+	unlink(knownPath.c_str());
+
+	close(listenfd);
+	unlink(sockPath.c_str());
+
+	exit(0);
+}
@@ -37,10 +37,10 @@ inline static double fw(double bad,double good,double badmsgs,double goodmsgs)
 }
 
 /* sum( ln( f(w) ) )*/
-inline static double sumQ(vector<double> fws)
+inline static double sumQ(const vector<double>& fws)
 {
 	double sum_r = 0.0;
-	for (vector<double>::iterator it = fws.begin(); it != fws.end(); ++it)
+	for (vector<double>::const_iterator it = fws.begin(); it != fws.end(); ++it)
 	{
 		sum_r += ln(*it);
 	}
@@ -49,10 +49,10 @@ inline static double sumQ(vector<double> fws)
 }
 
 /* sum( ln( 1-f(w) ) ) -- */
-inline static double sumP(vector<double> fws)
+inline static double sumP(const vector<double>& fws)
 {
 	double sum_r = 0.0;
-	for (vector<double>::iterator it = fws.begin(); it != fws.end(); ++it)
+	for (vector<double>::const_iterator it = fws.begin(); it != fws.end(); ++it)
 	{
 		sum_r += ln(1 - *it);
 	}
@@ -68,7 +68,7 @@ inline static double prbf(double x, double df)
 }
 
 /* S = (1 + Q - P) / 2 */
-inline static double spamicity(vector<double> fws)
+inline static double spamicity(const vector<double>& fws)
 {
 	double P = prbf(-2 * sumP(fws),2 * fws.size());
 	double Q = prbf(-2 * sumQ(fws),2 * fws.size());
@@ -0,0 +1,108 @@
+#include "CBloomFilter.h"
+#include "Hash.h"
+
+#include <stdio.h>
+
+/* second hash of the double hashing, any constant but HASH64_SEED */
+#define BLOOM_SEED2 0x9e3779b97f4a7c15ULL
+
+CBloomFilter::CBloomFilter()
+{
+	bits = 0;
+	hashes = 0;
+}
+
+CBloomFilter::~CBloomFilter()
+{
+}
+
+void CBloomFilter::Init(const size_t tokens,const unsigned int bitsPerToken)
+{
+	bits = (uint64_t)(tokens > 0 ? tokens : 1) * (bitsPerToken > 0 ? bitsPerToken : 1);
+	bits = (bits + 7) / 8 * 8;
+
+	/* k = ln2 * m/n, rounded */
+	hashes = (bitsPerToken * 69 + 50) / 100;
+	if (hashes == 0) hashes = 1;
+
+	bitmap.assign(bits / 8,'\0');
+}
+
+bool CBloomFilter::isEmpty() const
+{
+	return bits == 0;
+}
+
+string CBloomFilter::getParams() const
+{
+	char buffer[64] = {0};
+	snprintf(buffer,sizeof(buffer),"bits=%llu hashes=%u",(unsigned long long)bits,hashes);
+
+	return string(buffer);
+}
+
+bool CBloomFilter::setParams(const string& params)
+{
+	unsigned long long m = 0;
+	unsigned int k = 0;
+	if (sscanf(params.c_str(),"bits=%llu hashes=%u",&m,&k) != 2 || m == 0 || k == 0) return false;
+
+	/* the bitmap is allocated by the first Add() or setBitmap() */
+	bits = m;
+	hashes = k;
+	bitmap.clear();
+	return true;
+}
+
+/* Kirsch-Mitzenmacher: h1 + i*h2 */
+void CBloomFilter::getBits(const string& token,vector<uint64_t>& offsets) const
+{
+	offsets.clear();
+	if (bits == 0) return;
+
+	uint64_t h1 = hash64(token);
+	uint64_t h2 = hash64(token,BLOOM_SEED2) | 1;
+	for (unsigned int i = 0; i < hashes; ++i)
+	{
+		offsets.push_back((h1 + i * h2) % bits);
+	}
+}
+
+void CBloomFilter::Add(const string& token)
+{
+	vector<uint64_t> offsets;
+	getBits(token,offsets);
+	if (bitmap.size() < (bits + 7) / 8) bitmap.resize((bits + 7) / 8,'\0');
+	for (size_t i = 0; i < offsets.size(); ++i)
+	{
+		bitmap[offsets[i] >> 3] |= (char)(0x80 >> (offsets[i] & 7));
+	}
+}
+
+bool CBloomFilter::mayContain(const string& token) const
+{
+	/* no filter, no information */
+	if (bits == 0) return true;
+
+	uint64_t h1 = hash64(token);
+	uint64_t h2 = hash64(token,BLOOM_SEED2) | 1;
+	for (unsigned int i = 0; i < hashes; ++i)
+	{
+		uint64_t offset = (h1 + i * h2) % bits;
+		if ((offset >> 3) >= bitmap.size()) return false;
+		if (((unsigned char)bitmap[offset >> 3] & (0x80 >> (offset & 7))) == 0) return false;
+	}
+
+	return true;
+}
+
+const string& CBloomFilter::getBitmap() const
+{
+	return bitmap;
+}
+
+/* may be shorter than bits/8, redis doesn't allocate trailing zero bytes */
+void CBloomFilter::setBitmap(const string& bitmap_)
+{
+	bitmap = bitmap_;
+}
@@ -0,0 +1,57 @@
+#ifndef CBLOOMFILTER_H
+#define CBLOOMFILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/*
+ * Bloom filter of the tokens in the store. A token that fails it was
+ * never fed, so scanners don't look it up at all.
+ *
+ * The bits are kept in the store as a redis bitmap (BLOOM_KEY, SETBIT
+ * bit order: bit 0 is the high bit of byte 0) next to its parameters
+ * (BLOOM_PARAMS_KEY, "bits=<m> hashes=<k>"). feed sets the bits of new
+ * tokens, migrate -F rebuilds it. Tokens are never removed, unfeeding
+ * only leaves a false positive behind.
+ */
+#define BLOOM_KEY "antispam bloom"
+#define BLOOM_PARAMS_KEY "antispam bloom params"
+
+class CBloomFilter
+{
+public:
+	CBloomFilter();
+	~CBloomFilter();
+
+	/* size for tokens entries at bitsPerToken bits each (10: ~1% false positives) */
+	void Init(const size_t tokens,const unsigned int bitsPerToken = 10);
+	bool isEmpty() const;
+
+	/* parameters <-> "bits=<m> hashes=<k>" */
+	string getParams() const;
+	bool setParams(const string& params);
+
+	/* bit offsets of token, k of them */
+	void getBits(const string& token,vector<uint64_t>& bits) const;
+
+	void Add(const string& token);
+	bool mayContain(const string& token) const;
+
+	/* the bitmap as redis stores it */
+	const string& getBitmap() const;
+	/* take a bitmap read from redis, after setParams(); missing bytes are 0 */
+	void setBitmap(const string& bitmap);
+
+private:
+	uint64_t bits;
+	unsigned int hashes;
+	string bitmap;
+};
+
+#endif /*CBLOOMFILTER_H*/
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include <sstream>
 using std::stringstream;
 
@@ -0,0 +1,66 @@
+#include "CHotTable.h"
+#include "Hash.h"
+
+#include <string.h>
+
+CHotTable::CHotTable(const vector<string>& tokens,const vector<b_word_t>& words)
+{
+	size_t capacity = 16;
+	while (capacity < tokens.size() * 2) capacity <<= 1;
+
+	slot_t empty;
+	memset(&empty,0,sizeof(empty));
+	empty.offset = EMPTY_SLOT;
+	slots.assign(capacity,empty);
+	mask = capacity - 1;
+	size = 0;
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < tokens.size(); ++i) bytes += tokens[i].size();
+	pool.reserve(bytes);
+
+	b_word_t word;
+	for (size_t i = 0; i < tokens.size() && i < words.size(); ++i)
+	{
+		/* the pool is addressed with 32 bits */
+		if (pool.size() + tokens[i].size() >= EMPTY_SLOT) break;
+		if (Find(tokens[i],word)) continue;
+
+		uint64_t hash = hash64(tokens[i]);
+		size_t pos = hash & mask;
+		while (slots[pos].offset != EMPTY_SLOT) pos = (pos + 1) & mask;
+
+		slots[pos].hash = hash;
+		slots[pos].offset = pool.size();
+		slots[pos].len = tokens[i].size();
+		slots[pos].word = words[i];
+		pool.append(tokens[i]);
+		++size;
+	}
+}
+
+CHotTable::~CHotTable()
+{
+}
+
+bool CHotTable::Find(const string& token,b_word_t& word) const
+{
+	uint64_t hash = hash64(token);
+	for (size_t pos = hash & mask; slots[pos].offset != EMPTY_SLOT; pos = (pos + 1) & mask)
+	{
+		const slot_t& slot = slots[pos];
+		if (slot.hash == hash && slot.len == token.size()
+			&& memcmp(pool.data() + slot.offset,token.data(),slot.len) == 0)
+		{
+			word = slot.word;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t CHotTable::getSize() const
+{
+	return size;
+}
@@ -0,0 +1,51 @@
+#ifndef CHOTTABLE_H
+#define CHOTTABLE_H
+
+#include "TokenRecord.h"
+
+#include <stdint.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/*
+ * immutable token -> (bad, good) table of the most frequent tokens.
+ * Open addressing with linear probing over a power of two slot array,
+ * at most half full; the token bytes live in one flat pool. A probe
+ * compares the 64 bit hash first and only then the bytes, so a lookup is
+ * usually one or two cache lines. Built once, then only read, so any
+ * number of threads may Find() without locking.
+ */
+class CHotTable
+{
+public:
+	CHotTable(const vector<string>& tokens,const vector<b_word_t>& words);
+	~CHotTable();
+
+	bool Find(const string& token,b_word_t& word) const;
+	size_t getSize() const;
+
+private:
+	CHotTable(const CHotTable&);
+	CHotTable& operator=(const CHotTable&);
+
+	typedef struct slot_t_
+	{
+		uint64_t hash;
+		uint32_t offset;	/* EMPTY_SLOT if unused */
+		uint32_t len;
+		b_word_t word;
+	} slot_t;
+
+	static const uint32_t EMPTY_SLOT = 0xffffffff;
+
+	vector<slot_t> slots;
+	string pool;
+	size_t mask;
+	size_t size;
+};
+
+#endif /*CHOTTABLE_H*/
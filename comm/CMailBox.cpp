@@ -0,0 +1,174 @@
+#include "CMailBox.h"
+#include "Common.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+CMailBox::CMailBox()
+{
+	fileIndex = 0;
+	mboxIndex = 0;
+}
+
+CMailBox::~CMailBox()
+{
+	Close();
+}
+
+string CMailBox::getError()
+{
+	return errorMsg;
+}
+
+static bool is_dir(const string& path)
+{
+	struct stat statbuf;
+	return stat(path.c_str(),&statbuf) == 0 && S_ISDIR(statbuf.st_mode);
+}
+
+static bool is_file(const string& path)
+{
+	struct stat statbuf;
+	return stat(path.c_str(),&statbuf) == 0 && S_ISREG(statbuf.st_mode);
+}
+
+static bool list_dir(const string& dir,vector<string>& files)
+{
+	DIR* d = opendir(dir.c_str());
+	if (d == NULL) return false;
+
+	struct dirent* entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		if (entry->d_name[0] == '.') continue;
+
+		string file = dir + "/" + entry->d_name;
+		if (is_file(file)) files.push_back(file);
+	}
+	closedir(d);
+
+	sort(files.begin(),files.end());
+	return true;
+}
+
+bool CMailBox::Open(const string& path_)
+{
+	Close();
+	path = path_;
+
+	if (is_dir(path + "/cur") && is_dir(path + "/new"))
+	{
+		if (!list_dir(path + "/cur",files) || !list_dir(path + "/new",files))
+		{
+			errorMsg = path + ": " + strerror(errno);
+			return false;
+		}
+		return true;
+	}
+
+	if (is_dir(path))
+	{
+		if (!list_dir(path,files))
+		{
+			errorMsg = path + ": " + strerror(errno);
+			return false;
+		}
+		return true;
+	}
+
+	mbox.open(path.c_str(),std::ios::in | std::ios::binary);
+	if (!mbox)
+	{
+		errorMsg = path + ": " + strerror(errno);
+		return false;
+	}
+
+	return true;
+}
+
+void CMailBox::Close()
+{
+	files.clear();
+	fileIndex = 0;
+
+	if (mbox.is_open()) mbox.close();
+	mbox.clear();
+	pendingLine = "";
+	mboxIndex = 0;
+}
+
+bool CMailBox::Next(string& name,string& data)
+{
+	if (mbox.is_open()) return nextMbox(name,data);
+
+	return nextFile(name,data);
+}
+
+bool CMailBox::nextFile(string& name,string& data)
+{
+	while (fileIndex < files.size())
+	{
+		name = files[fileIndex++];
+
+		ifstream in(name.c_str(),std::ios::in | std::ios::binary);
+		if (!in) continue;
+
+		std::stringstream buffer;
+		buffer << in.rdbuf();
+		data = buffer.str();
+		return true;
+	}
+
+	return false;
+}
+
+/* only line ends, what is left of a message between two separators */
+static bool is_blank(const string& data)
+{
+	return data.find_first_not_of("\r\n") == string::npos;
+}
+
+/* the "From " separator line itself is not part of the message. An empty
+ * message is skipped, it still counts for the numbering */
+bool CMailBox::nextMbox(string& name,string& data)
+{
+	string line;
+	data.clear();
+
+	bool started = (pendingLine != "");
+	pendingLine = "";
+
+	while (getline(mbox,line))
+	{
+		if (line.compare(0,5,"From ") == 0)
+		{
+			if (started && !is_blank(data))
+			{
+				pendingLine = line;
+				break;
+			}
+			if (started) ++mboxIndex;
+			data.clear();
+			started = true;
+			continue;
+		}
+
+		/* mboxrd: a body line ">*From " was written with one more '>' */
+		size_t quotes = line.find_first_not_of('>');
+		if (quotes > 0 && quotes != string::npos && line.compare(quotes,5,"From ") == 0) line.erase(0,1);
+
+		data += line;
+		data += '\n';
+	}
+
+	if (is_blank(data)) return false;
+
+	name = path + ":" + my_int2str(++mboxIndex);
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef CMAILBOX_H
+#define CMAILBOX_H
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <fstream>
+using std::ifstream;
+
+/*
+ * iterate the messages of a mail corpus:
+ *	directory -- every regular file in it is one message
+ *	Maildir   -- a directory with cur/ and new/, every file in them
+ *	mbox      -- messages separated by "From " lines, mboxrd ">From " undone
+ */
+class CMailBox
+{
+	public:
+		CMailBox();
+		~CMailBox();
+
+		bool Open(const string& path);
+		/* name is the file of the message, or "<mbox>:<n>" */
+		bool Next(string& name,string& data);
+		void Close();
+
+		string getError();
+
+	private:
+		CMailBox(const CMailBox&);
+		CMailBox& operator=(const CMailBox&);
+
+		bool nextFile(string& name,string& data);
+		bool nextMbox(string& name,string& data);
+
+		string path;
+		string errorMsg;
+
+		vector<string> files;
+		size_t fileIndex;
+
+		ifstream mbox;
+		string pendingLine;
+		unsigned long mboxIndex;
+};
+
+#endif /*CMAILBOX_H*/
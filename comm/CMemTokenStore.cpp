@@ -0,0 +1,88 @@
+#include "CMemTokenStore.h"
+
+CMemTokenStore::CMemTokenStore()
+{
+	pthread_mutex_init(&lock,NULL);
+	hashed = false;
+}
+
+CMemTokenStore::~CMemTokenStore()
+{
+	pthread_mutex_destroy(&lock);
+}
+
+bool CMemTokenStore::Lookup(const vector<string>& tokens,vector<b_word_t>& words_,vector<bool>& found)
+{
+	b_word_t zero = {0,0};
+	words_.assign(tokens.size(),zero);
+	found.assign(tokens.size(),false);
+
+	pthread_mutex_lock(&lock);
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		words_t::const_iterator it = words.find(tokens[i]);
+		if (it == words.end()) continue;
+
+		words_[i] = it->second;
+		found[i] = true;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return true;
+}
+
+/* same rules as the redis scripts, see CTokenDb */
+bool CMemTokenStore::Add(const vector<string>& tokens,const vector<b_word_t>& deltas)
+{
+	pthread_mutex_lock(&lock);
+	for (size_t i = 0; i < tokens.size() && i < deltas.size(); ++i)
+	{
+		words_t::iterator it = words.find(tokens[i]);
+		if (it == words.end())
+		{
+			if (deltas[i].bad < 0 || deltas[i].good < 0) continue;
+			b_word_t zero = {0,0};
+			it = words.insert(make_pair(tokens[i],zero)).first;
+		}
+
+		it->second.bad += deltas[i].bad;
+		it->second.good += deltas[i].good;
+		if (it->second.bad < 0) it->second.bad = 0;
+		if (it->second.good < 0) it->second.good = 0;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return true;
+}
+
+string CMemTokenStore::getError()
+{
+	return "";
+}
+
+void CMemTokenStore::Load(const vector<string>& tokens,const vector<b_word_t>& words_,const bool hashed_)
+{
+	pthread_mutex_lock(&lock);
+	hashed = hashed_;
+	words.clear();
+	words.rehash(tokens.size());
+	for (size_t i = 0; i < tokens.size() && i < words_.size(); ++i)
+	{
+		words[tokens[i]] = words_[i];
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+bool CMemTokenStore::isHashed()
+{
+	return hashed;
+}
+
+size_t CMemTokenStore::getSize()
+{
+	pthread_mutex_lock(&lock);
+	size_t size = words.size();
+	pthread_mutex_unlock(&lock);
+
+	return size;
+}
@@ -0,0 +1,42 @@
+#ifndef CMEMTOKENSTORE_H
+#define CMEMTOKENSTORE_H
+
+#include "CTokenStore.h"
+
+#include <pthread.h>
+
+#include <tr1/unordered_map>
+
+/*
+ * token store in process memory, for tests, benchmarks and single host
+ * setups. Thread safe; one lock per batch.
+ */
+class CMemTokenStore : public CTokenStore
+{
+public:
+	CMemTokenStore();
+	virtual ~CMemTokenStore();
+
+	using CTokenStore::Add;
+
+	virtual bool Lookup(const vector<string>& tokens,vector<b_word_t>& words,vector<bool>& found);
+	virtual bool Add(const vector<string>& tokens,const vector<b_word_t>& deltas);
+	virtual string getError();
+
+	/* replace the contents, e.g. with CTokenFile::getAll() */
+	void Load(const vector<string>& tokens,const vector<b_word_t>& words,const bool hashed = false);
+	virtual bool isHashed();
+	size_t getSize();
+
+private:
+	CMemTokenStore(const CMemTokenStore&);
+	CMemTokenStore& operator=(const CMemTokenStore&);
+
+	typedef std::tr1::unordered_map<string,b_word_t> words_t;
+
+	pthread_mutex_t lock;
+	words_t words;
+	bool hashed;
+};
+
+#endif /*CMEMTOKENSTORE_H*/
@@ -0,0 +1,123 @@
+#include "CRefresher.h"
+
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
+CRefresher::CRefresher()
+{
+	pthread_mutex_init(&lock,NULL);
+	pthread_cond_init(&wakeup,NULL);
+	running = false;
+	interval = 0;
+	snapshotPath = "";
+	snapshotReader = false;
+}
+
+CRefresher::~CRefresher()
+{
+	Stop();
+
+	pthread_cond_destroy(&wakeup);
+	pthread_mutex_destroy(&lock);
+}
+
+bool CRefresher::Start(const int interval_)
+{
+	pthread_mutex_lock(&lock);
+	if (running)
+	{
+		pthread_mutex_unlock(&lock);
+		return true;
+	}
+	interval = interval_ > 0 ? interval_ : 1;
+	running = true;
+	pthread_mutex_unlock(&lock);
+
+	if (pthread_create(&thread,NULL,refreshMain,this) != 0)
+	{
+		pthread_mutex_lock(&lock);
+		running = false;
+		errorMsg = "can't create refresh thread";
+		pthread_mutex_unlock(&lock);
+		return false;
+	}
+
+	return true;
+}
+
+void CRefresher::Stop()
+{
+	pthread_mutex_lock(&lock);
+	bool wasRunning = running;
+	running = false;
+	pthread_cond_signal(&wakeup);
+	pthread_mutex_unlock(&lock);
+
+	if (wasRunning) pthread_join(thread,NULL);
+}
+
+void CRefresher::setSnapshot(const string& path,const bool reader)
+{
+	snapshotPath = path;
+	snapshotReader = reader;
+	snapshotLoaded = "";
+}
+
+/* the builder renames a new file over the old one, so inode and mtime
+ * change with every table it writes */
+string CRefresher::getSnapshotVersion()
+{
+	struct stat st;
+	if (stat(snapshotPath.c_str(),&st) != 0) return "";
+
+	char version[128] = {0};
+	snprintf(version,sizeof(version),"%lu %ld %ld %lld",(unsigned long)st.st_ino,(long)st.st_mtim.tv_sec,
+		(long)st.st_mtim.tv_nsec,(long long)st.st_size);
+
+	return version;
+}
+
+string CRefresher::getError()
+{
+	pthread_mutex_lock(&lock);
+	string ret = errorMsg;
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
+
+void CRefresher::setError(const string& error)
+{
+	pthread_mutex_lock(&lock);
+	errorMsg = error;
+	pthread_mutex_unlock(&lock);
+}
+
+void* CRefresher::refreshMain(void* arg)
+{
+	((CRefresher*)arg)->refresh();
+	return NULL;
+}
+
+void CRefresher::refresh()
+{
+	pthread_mutex_lock(&lock);
+	while (running)
+	{
+		struct timeval now;
+		gettimeofday(&now,NULL);
+		struct timespec deadline;
+		deadline.tv_sec = now.tv_sec + interval;
+		deadline.tv_nsec = now.tv_usec * 1000;
+
+		while (running && pthread_cond_timedwait(&wakeup,&lock,&deadline) == 0);
+		if (!running) break;
+
+		/* the old table keeps serving while the new one is built */
+		pthread_mutex_unlock(&lock);
+		Load();
+		pthread_mutex_lock(&lock);
+	}
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,63 @@
+#ifndef CREFRESHER_H
+#define CREFRESHER_H
+
+#include <pthread.h>
+
+#include <string>
+using std::string;
+
+/*
+ * calls Load() of the derived class every interval seconds on a thread
+ * of its own, for tables that are rebuilt in the background and swapped
+ * in under lock. Derived destructors must call Stop().
+ *
+ * With a snapshot file one process builds the table and the others only
+ * read it: the builder's Load() writes every table it builds there, a
+ * reader's Load() loads the file instead of asking the store, and only
+ * when the builder has replaced it since.
+ */
+class CRefresher
+{
+public:
+	CRefresher();
+	virtual ~CRefresher();
+
+	virtual bool Load() = 0;
+
+	/* Load() every interval seconds until Stop() */
+	bool Start(const int interval);
+	void Stop();
+
+	/* before the first Load(); reader false builds and writes path */
+	void setSnapshot(const string& path,const bool reader);
+
+	string getError();
+
+protected:
+	void setError(const string& error);
+
+	string snapshotPath;
+	bool snapshotReader;
+	/* identity of the file at snapshotPath, "" if there is none */
+	string getSnapshotVersion();
+	/* getSnapshotVersion() of the file a reader loaded last */
+	string snapshotLoaded;
+
+	/* guards errorMsg and whatever the derived class swaps */
+	pthread_mutex_t lock;
+
+private:
+	CRefresher(const CRefresher&);
+	CRefresher& operator=(const CRefresher&);
+
+	static void* refreshMain(void* arg);
+	void refresh();
+
+	pthread_cond_t wakeup;
+	pthread_t thread;
+	bool running;
+	int interval;
+	string errorMsg;
+};
+
+#endif /*CREFRESHER_H*/
@@ -0,0 +1,151 @@
+#include "CTokenCache.h"
+#include "Hash.h"
+
+CTokenCache::CTokenCache(const size_t capacity,const int ttl_) : ttl(ttl_)
+{
+	shardCapacity = (capacity + SHARDS - 1) / SHARDS;
+	if (shardCapacity == 0) shardCapacity = 1;
+
+	for (size_t i = 0; i < SHARDS; ++i)
+	{
+		pthread_mutex_init(&shards[i].lock,NULL);
+		shards[i].hits = 0;
+		shards[i].misses = 0;
+	}
+}
+
+CTokenCache::~CTokenCache()
+{
+	for (size_t i = 0; i < SHARDS; ++i)
+	{
+		pthread_mutex_destroy(&shards[i].lock);
+	}
+}
+
+CTokenCache::shard_t* CTokenCache::shardOf(const string& token)
+{
+	return &shards[hash64(token) % SHARDS];
+}
+
+void CTokenCache::Lookup(const vector<string>& tokens,vector<b_word_t>& words,
+		vector<bool>& found,vector<size_t>& missing)
+{
+	b_word_t zero = {0,0};
+	words.assign(tokens.size(),zero);
+	found.assign(tokens.size(),false);
+	missing.clear();
+
+	time_t now = time(NULL);
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		shard_t* shard = shardOf(tokens[i]);
+		pthread_mutex_lock(&shard->lock);
+
+		index_t::iterator it = shard->index.find(tokens[i]);
+		if (it != shard->index.end() && it->second->expires > now)
+		{
+			words[i] = it->second->word;
+			found[i] = it->second->found;
+			shard->lru.splice(shard->lru.begin(),shard->lru,it->second);
+			++shard->hits;
+		}
+		else
+		{
+			missing.push_back(i);
+			++shard->misses;
+		}
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+void CTokenCache::Store(const vector<string>& tokens,const vector<size_t>& indexes,
+		const vector<b_word_t>& words,const vector<bool>& found)
+{
+	time_t expires = time(NULL) + ttl;
+	for (size_t j = 0; j < indexes.size(); ++j)
+	{
+		size_t i = indexes[j];
+		shard_t* shard = shardOf(tokens[i]);
+		pthread_mutex_lock(&shard->lock);
+
+		index_t::iterator it = shard->index.find(tokens[i]);
+		if (it != shard->index.end())
+		{
+			shard->lru.splice(shard->lru.begin(),shard->lru,it->second);
+		}
+		else
+		{
+			if (shard->lru.size() >= shardCapacity)
+			{
+				shard->index.erase(shard->lru.back().token);
+				shard->lru.pop_back();
+			}
+			shard->lru.push_front(entry_t());
+			shard->lru.front().token = tokens[i];
+			shard->index[tokens[i]] = shard->lru.begin();
+		}
+
+		entry_t& entry = shard->lru.front();
+		entry.word = words[i];
+		entry.found = found[i];
+		entry.expires = expires;
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+void CTokenCache::Clear()
+{
+	for (size_t i = 0; i < SHARDS; ++i)
+	{
+		pthread_mutex_lock(&shards[i].lock);
+		shards[i].index.clear();
+		shards[i].lru.clear();
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+}
+
+size_t CTokenCache::getCapacity()
+{
+	return shardCapacity * SHARDS;
+}
+
+size_t CTokenCache::getSize()
+{
+	size_t size = 0;
+	for (size_t i = 0; i < SHARDS; ++i)
+	{
+		pthread_mutex_lock(&shards[i].lock);
+		size += shards[i].lru.size();
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+
+	return size;
+}
+
+unsigned long CTokenCache::getHits()
+{
+	unsigned long hits = 0;
+	for (size_t i = 0; i < SHARDS; ++i)
+	{
+		pthread_mutex_lock(&shards[i].lock);
+		hits += shards[i].hits;
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+
+	return hits;
+}
+
+unsigned long CTokenCache::getMisses()
+{
+	unsigned long misses = 0;
+	for (size_t i = 0; i < SHARDS; ++i)
+	{
+		pthread_mutex_lock(&shards[i].lock);
+		misses += shards[i].misses;
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+
+	return misses;
+}
@@ -0,0 +1,81 @@
+#ifndef CTOKENCACHE_H
+#define CTOKENCACHE_H
+
+#include "TokenRecord.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <list>
+using std::list;
+
+#include <tr1/unordered_map>
+
+/*
+ * bounded token -> (bad, good) cache in front of the store, shared by
+ * all threads of a process. Unknown tokens are cached too, a miss costs
+ * the same round trip as a hit.
+ *
+ * Entries expire after ttl seconds, so counts that feed changed show up
+ * again without a restart. Eviction is LRU per shard; the shard is picked
+ * by the token hash, so threads rarely wait on the same lock.
+ */
+class CTokenCache
+{
+public:
+	CTokenCache(const size_t capacity = 100000,const int ttl = 300);
+	~CTokenCache();
+
+	/* fill what is cached, missing gets the indexes of the other tokens */
+	void Lookup(const vector<string>& tokens,vector<b_word_t>& words,
+		vector<bool>& found,vector<size_t>& missing);
+	/* remember the store's answer for tokens[i], i in indexes */
+	void Store(const vector<string>& tokens,const vector<size_t>& indexes,
+		const vector<b_word_t>& words,const vector<bool>& found);
+	void Clear();
+
+	size_t getCapacity();
+	size_t getSize();
+	unsigned long getHits();
+	unsigned long getMisses();
+
+private:
+	CTokenCache(const CTokenCache&);
+	CTokenCache& operator=(const CTokenCache&);
+
+	typedef struct entry_t_
+	{
+		string token;
+		b_word_t word;
+		bool found;
+		time_t expires;
+	} entry_t;
+
+	typedef list<entry_t> lru_t;
+	typedef std::tr1::unordered_map<string,lru_t::iterator> index_t;
+
+	typedef struct shard_t_
+	{
+		pthread_mutex_t lock;
+		lru_t lru;	/* most recently used first */
+		index_t index;
+		unsigned long hits;
+		unsigned long misses;
+	} shard_t;
+
+	static const size_t SHARDS = 16;
+
+	shard_t* shardOf(const string& token);
+
+	shard_t shards[SHARDS];
+	size_t shardCapacity;
+	int ttl;
+};
+
+#endif /*CTOKENCACHE_H*/
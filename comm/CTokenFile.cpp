@@ -0,0 +1,246 @@
+#include "CTokenFile.h"
+#include "Hash.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+CTokenFile::CTokenFile()
+{
+	base = NULL;
+	length = 0;
+	slots = NULL;
+	pool = NULL;
+	poolSize = 0;
+	mask = 0;
+	tokens = 0;
+	flags = 0;
+}
+
+CTokenFile::~CTokenFile()
+{
+	Close();
+}
+
+bool CTokenFile::Write(const string& path,const vector<string>& tokens,
+		const vector<b_word_t>& words,const bool hashed,string& error)
+{
+	uint32_t capacity = 16;
+	while (capacity < tokens.size() * 2) capacity <<= 1;
+
+	slot_t empty;
+	memset(&empty,0,sizeof(empty));
+	empty.offset = EMPTY_SLOT;
+	vector<slot_t> table(capacity,empty);
+	string pool;
+
+	uint32_t count = 0;
+	for (size_t i = 0; i < tokens.size() && i < words.size(); ++i)
+	{
+		if (pool.size() + tokens[i].size() >= EMPTY_SLOT)
+		{
+			error = "token pool over 4GB";
+			return false;
+		}
+
+		uint64_t hash = hash64(tokens[i]);
+		uint32_t pos = hash & (capacity - 1);
+		bool dup = false;
+		for (; table[pos].offset != EMPTY_SLOT; pos = (pos + 1) & (capacity - 1))
+		{
+			if (table[pos].hash == hash && table[pos].len == tokens[i].size()
+				&& pool.compare(table[pos].offset,table[pos].len,tokens[i]) == 0)
+			{
+				dup = true;
+				break;
+			}
+		}
+		if (dup) continue;
+
+		table[pos].hash = hash;
+		table[pos].offset = pool.size();
+		table[pos].len = tokens[i].size();
+		table[pos].bad = words[i].bad;
+		table[pos].good = words[i].good;
+		pool.append(tokens[i]);
+		++count;
+	}
+
+	header_t header;
+	memcpy(header.magic,"ASTF",4);
+	header.version = VERSION;
+	header.slots = capacity;
+	header.tokens = count;
+	header.flags = hashed ? TOKEN_FILE_HASHED : 0;
+	header.reserved = 0;
+
+	string tmp = path + ".tmp";
+	FILE* fp = fopen(tmp.c_str(),"wb");
+	if (fp == NULL)
+	{
+		error = tmp + ": " + strerror(errno);
+		return false;
+	}
+
+	bool ok = fwrite(&header,sizeof(header),1,fp) == 1
+		&& fwrite(&table[0],sizeof(slot_t),table.size(),fp) == table.size()
+		&& (pool.empty() || fwrite(pool.data(),pool.size(),1,fp) == 1);
+	ok = (fclose(fp) == 0) && ok;
+
+	if (!ok || rename(tmp.c_str(),path.c_str()) != 0)
+	{
+		error = path + ": " + strerror(errno);
+		unlink(tmp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool CTokenFile::Open(const string& path)
+{
+	Close();
+
+	int fd = open(path.c_str(),O_RDONLY);
+	if (fd < 0)
+	{
+		errorMsg = path + ": " + strerror(errno);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd,&st) != 0 || (size_t)st.st_size < sizeof(header_t))
+	{
+		errorMsg = path + ": not a token file";
+		close(fd);
+		return false;
+	}
+
+	void* map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		errorMsg = path + ": " + strerror(errno);
+		return false;
+	}
+	base = (const char*)map;
+	length = st.st_size;
+
+	/* lookups jump around, don't read ahead */
+	madvise(map,length,MADV_RANDOM);
+
+	const header_t* header = (const header_t*)base;
+	size_t headerSize = (header->version == 1) ? HEADER_V1_SIZE : sizeof(header_t);
+	size_t tableEnd = headerSize + (size_t)header->slots * sizeof(slot_t);
+	if (memcmp(header->magic,"ASTF",4) != 0 || header->version == 0 || header->version > VERSION
+		|| header->slots == 0 || (header->slots & (header->slots - 1)) != 0
+		|| tableEnd > length)
+	{
+		errorMsg = path + ": not a token file, or written on another architecture";
+		Close();
+		return false;
+	}
+
+	slots = (const slot_t*)(base + headerSize);
+	pool = base + tableEnd;
+	poolSize = length - tableEnd;
+	mask = header->slots - 1;
+	tokens = header->tokens;
+	flags = (header->version == 1) ? 0 : header->flags;
+
+	return true;
+}
+
+void CTokenFile::Close()
+{
+	if (base != NULL) munmap((void*)base,length);
+
+	base = NULL;
+	length = 0;
+	slots = NULL;
+	pool = NULL;
+	poolSize = 0;
+	mask = 0;
+	tokens = 0;
+	flags = 0;
+}
+
+bool CTokenFile::isOpen() const
+{
+	return base != NULL;
+}
+
+bool CTokenFile::Find(const string& token,b_word_t& word) const
+{
+	if (slots == NULL) return false;
+
+	uint64_t hash = hash64(token);
+	for (uint32_t pos = hash & mask; slots[pos].offset != EMPTY_SLOT; pos = (pos + 1) & mask)
+	{
+		const slot_t& slot = slots[pos];
+		if (slot.hash == hash && slot.len == token.size()
+			&& (size_t)slot.offset + slot.len <= poolSize
+			&& memcmp(pool + slot.offset,token.data(),slot.len) == 0)
+		{
+			word.bad = slot.bad;
+			word.good = slot.good;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CTokenFile::getAll(vector<string>& tokens_,vector<b_word_t>& words) const
+{
+	tokens_.clear();
+	words.clear();
+	for (uint32_t pos = 0; slots != NULL && pos <= mask; ++pos)
+	{
+		const slot_t& slot = slots[pos];
+		if (slot.offset == EMPTY_SLOT || (size_t)slot.offset + slot.len > poolSize) continue;
+
+		b_word_t word = {slot.bad,slot.good};
+		tokens_.push_back(string(pool + slot.offset,slot.len));
+		words.push_back(word);
+	}
+}
+
+size_t CTokenFile::getSize() const
+{
+	return tokens;
+}
+
+bool CTokenFile::Lookup(const vector<string>& tokens_,vector<b_word_t>& words,vector<bool>& found)
+{
+	b_word_t zero = {0,0};
+	words.assign(tokens_.size(),zero);
+	found.assign(tokens_.size(),false);
+
+	for (size_t i = 0; i < tokens_.size(); ++i)
+	{
+		found[i] = Find(tokens_[i],words[i]);
+	}
+
+	return true;
+}
+
+bool CTokenFile::Add(const vector<string>&,const vector<b_word_t>&)
+{
+	errorMsg = "token file is read-only";
+	return false;
+}
+
+string CTokenFile::getError()
+{
+	return errorMsg;
+}
+
+bool CTokenFile::isHashed()
+{
+	return (flags & TOKEN_FILE_HASHED) != 0;
+}
@@ -0,0 +1,98 @@
+#ifndef CTOKENFILE_H
+#define CTOKENFILE_H
+
+#include "CTokenStore.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/*
+ * read-only token database in one file, for scanners without redis
+ *
+ *	header   magic "ASTF", version, slot count (power of 2), token count,
+ *	         flags (v2: TOKEN_FILE_HASHED), reserved
+ *	slots    open addressing table, linear probing, at most half full
+ *	         { uint64 hash64(token), uint32 offset, uint32 len,
+ *	           int32 bad, int32 good }, offset 0xffffffff = empty
+ *	pool     token bytes, slots point into it
+ *
+ * Numbers are in host byte order; the magic doubles as endian check.
+ * The file is mmap()ed read-only, so every scanner on a host shares one
+ * page cached copy and a lookup is a probe in local memory.
+ */
+class CTokenFile : public CTokenStore
+{
+public:
+	CTokenFile();
+	virtual ~CTokenFile();
+
+	using CTokenStore::Add;
+
+	/* written to path.tmp and renamed, scanners that have the old file
+	 * open keep their mapping */
+	static bool Write(const string& path,const vector<string>& tokens,
+		const vector<b_word_t>& words,const bool hashed,string& error);
+
+	bool Open(const string& path);
+	void Close();
+	bool isOpen() const;
+
+	bool Find(const string& token,b_word_t& word) const;
+	/* every token, in file order */
+	void getAll(vector<string>& tokens,vector<b_word_t>& words) const;
+	size_t getSize() const;
+
+	virtual bool Lookup(const vector<string>& tokens,vector<b_word_t>& words,vector<bool>& found);
+	/* read-only, always fails */
+	virtual bool Add(const vector<string>& tokens,const vector<b_word_t>& deltas);
+	virtual string getError();
+	/* exported from a hashed store */
+	virtual bool isHashed();
+
+private:
+	CTokenFile(const CTokenFile&);
+	CTokenFile& operator=(const CTokenFile&);
+
+	typedef struct header_t_
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t slots;
+		uint32_t tokens;
+		uint32_t flags;		/* v2 */
+		uint32_t reserved;
+	} header_t;
+
+	typedef struct slot_t_
+	{
+		uint64_t hash;
+		uint32_t offset;
+		uint32_t len;
+		int32_t bad;
+		int32_t good;
+	} slot_t;
+
+	static const uint32_t EMPTY_SLOT = 0xffffffff;
+	static const uint32_t VERSION = 2;
+	static const uint32_t TOKEN_FILE_HASHED = 0x1;
+	/* v1 had no flags */
+	static const size_t HEADER_V1_SIZE = 16;
+
+	const char* base;
+	size_t length;
+	const slot_t* slots;
+	const char* pool;
+	size_t poolSize;
+	uint32_t mask;
+	uint32_t tokens;
+	uint32_t flags;
+	string errorMsg;
+};
+
+#endif /*CTOKENFILE_H*/
@@ -0,0 +1,167 @@
+#include "CTokenKey.h"
+#include "Hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* stored in the token store like HASH64_SEED: never change them */
+const uint64_t BIGRAM_BASE = 0x9e3779b97f4a7c15ULL;
+const uint64_t BIGRAM_SEED = 0xb16babe5ULL;
+
+CTokenKey::CTokenKey()
+{
+	buckets = 0;
+	hashed = false;
+}
+
+CTokenKey::~CTokenKey()
+{
+
+}
+
+void CTokenKey::setBuckets(const unsigned int buckets_)
+{
+	buckets = buckets_;
+}
+
+unsigned int CTokenKey::getBuckets() const
+{
+	return buckets;
+}
+
+bool CTokenKey::isBucketed() const
+{
+	return buckets > 0;
+}
+
+void CTokenKey::setHashed(const bool hashed_)
+{
+	hashed = hashed_;
+}
+
+bool CTokenKey::isHashed() const
+{
+	return hashed;
+}
+
+string CTokenKey::getLayout() const
+{
+	char buffer[64] = {0};
+	snprintf(buffer,sizeof(buffer),"buckets=%u%s",buckets,hashed ? " hashed" : "");
+
+	return string(buffer);
+}
+
+bool CTokenKey::setLayout(const string& layout)
+{
+	unsigned int n = 0;
+	char flag[16] = {0};
+	int fields = 0;
+	if (layout != "" && (fields = sscanf(layout.c_str(),"buckets=%u %15s",&n,flag)) < 1) return false;
+	if (fields == 2 && strcmp(flag,"hashed") != 0) return false;
+
+	buckets = n;
+	hashed = (fields == 2);
+	return true;
+}
+
+string CTokenKey::key(const string& token) const
+{
+	if (buckets == 0) return token;
+
+	return bucket((unsigned int)(hash64(token) % buckets));
+}
+
+string CTokenKey::bucket(const unsigned int n) const
+{
+	char buffer[32] = {0};
+	snprintf(buffer,sizeof(buffer),"bucket %u",n);
+
+	return string(buffer);
+}
+
+string CTokenKey::badField(const string& token) const
+{
+	return "b" + token;
+}
+
+string CTokenKey::goodField(const string& token) const
+{
+	return "g" + token;
+}
+
+bool CTokenKey::isTokenKey(const string& key) const
+{
+	return hashed ? key.size() == HASHED_TOKEN_SIZE : !isReserved(key);
+}
+
+string CTokenKey::hashToken(const string& token)
+{
+	return hashToken(token.data(),token.size());
+}
+
+string CTokenKey::hashToken(const char* data,const size_t len)
+{
+	uint64_t h = hash64(data,len);
+	char bytes[HASHED_TOKEN_SIZE];
+	for (int i = 0; i < HASHED_TOKEN_SIZE; ++i)
+	{
+		bytes[i] = (char)(h >> (8 * i));
+	}
+
+	return string(bytes,HASHED_TOKEN_SIZE);
+}
+
+void CTokenKey::bigramKey(const uint64_t first,const uint64_t second,char key[BIGRAM_KEY_SIZE])
+{
+	/* polynomial rolling hash over the token hashes, then mixed again so
+	 * nearby values don't give nearby keys */
+	uint64_t h = first * BIGRAM_BASE + second;
+	h = hash64(&h,sizeof(h),BIGRAM_SEED);
+
+	static const char HEX[] = "0123456789abcdef";
+	key[0] = BIGRAM_TAG;
+	for (int i = 0; i < 16; ++i)
+	{
+		key[16 - i] = HEX[(h >> (4 * i)) & 0xF];
+	}
+}
+
+bool CTokenKey::isBigram(const string& token)
+{
+	return token.size() == BIGRAM_KEY_SIZE && token[0] == BIGRAM_TAG;
+}
+
+string CTokenKey::hashToHex(const string& hashed)
+{
+	uint64_t h = 0;
+	for (size_t i = 0; i < hashed.size() && i < HASHED_TOKEN_SIZE; ++i)
+	{
+		h |= (uint64_t)(unsigned char)hashed[i] << (8 * i);
+	}
+
+	char buffer[32] = {0};
+	snprintf(buffer,sizeof(buffer),"%016llx",(unsigned long long)h);
+	return string(buffer);
+}
+
+bool CTokenKey::hexToHash(const string& hex,string& hashed)
+{
+	unsigned long long h = 0;
+	char end = 0;
+	if (hex.size() != 2 * HASHED_TOKEN_SIZE || sscanf(hex.c_str(),"%llx%c",&h,&end) != 1) return false;
+
+	char bytes[HASHED_TOKEN_SIZE];
+	for (int i = 0; i < HASHED_TOKEN_SIZE; ++i)
+	{
+		bytes[i] = (char)(h >> (8 * i));
+	}
+	hashed.assign(bytes,HASHED_TOKEN_SIZE);
+	return true;
+}
+
+bool CTokenKey::isReserved(const string& key)
+{
+	return key.find(' ') != string::npos;
+}
@@ -0,0 +1,84 @@
+#ifndef CTOKENKEY_H
+#define CTOKENKEY_H
+
+#include <stdint.h>
+
+#include <string>
+using std::string;
+
+/*
+ * where a token lives in the store
+ *
+ * buckets == 0: one string key per token, value is a TokenRecord
+ * buckets  > 0: token is hashed into one of N redis HASHes named
+ *               "bucket <n>", with integer fields "b<token>" (spam count)
+ *               and "g<token>" (ham count). Small hashes are kept in the
+ *               compact listpack encoding, keep
+ *               tokens/buckets*2 < hash-max-listpack-entries.
+ *
+ * hashed:       the store holds hashToken(token), the 8 byte hash64 of
+ *               the token, instead of the token itself: fixed size keys
+ *               and fields however long a url is. Callers translate
+ *               before they touch the store, so everything built from it
+ *               (hot table, bloom filter, exported file) is keyed by the
+ *               hash too. feed --names keeps hash -> token in NAMES_KEY
+ *               for lexer.
+ *
+ * The layout is stored in the LAYOUT_KEY of the store itself, so feed and
+ * all scanners agree on it. Reserved keys contain a space, which a token
+ * never does, and are longer than a hashed token.
+ */
+#define LAYOUT_KEY "antispam layout"
+#define NAMES_KEY "antispam names"
+
+/* size of hashToken() */
+#define HASHED_TOKEN_SIZE 8
+
+/* bigramKey(): BIGRAM_TAG and 16 hex digits. scws never makes a token
+ * with a control character, hex keeps the key free of spaces */
+#define BIGRAM_TAG '\x01'
+#define BIGRAM_KEY_SIZE 17
+
+class CTokenKey
+{
+public:
+	CTokenKey();
+	~CTokenKey();
+
+	void setBuckets(const unsigned int buckets);
+	unsigned int getBuckets() const;
+	bool isBucketed() const;
+	void setHashed(const bool hashed);
+	bool isHashed() const;
+
+	/* layout <-> "buckets=<n>[ hashed]" value of LAYOUT_KEY */
+	string getLayout() const;
+	bool setLayout(const string& layout);
+
+	string key(const string& token) const;
+	/* name of bucket n */
+	string bucket(const unsigned int n) const;
+	string badField(const string& token) const;
+	string goodField(const string& token) const;
+
+	/* a key holding a token in the string layout */
+	bool isTokenKey(const string& key) const;
+	static bool isReserved(const string& key);
+
+	/* stable across hosts: the bytes of hash64(token), little endian */
+	static string hashToken(const string& token);
+	static string hashToken(const char* data,const size_t len);
+	/* the token standing for "first second", from the hash64 of both; no
+	 * string of the two is made */
+	static void bigramKey(const uint64_t first,const uint64_t second,char key[BIGRAM_KEY_SIZE]);
+	static bool isBigram(const string& token);
+	/* hashToken() <-> 16 hex digits */
+	static string hashToHex(const string& hashed);
+	static bool hexToHash(const string& hex,string& hashed);
+
+private:
+	unsigned int buckets;
+	bool hashed;
+};
+
+#endif /*CTOKENKEY_H*/
@@ -0,0 +1,46 @@
+#ifndef CTOKENSTORE_H
+#define CTOKENSTORE_H
+
+#include "TokenRecord.h"
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/*
+ * where the token counters live. Scoring and training only talk to this,
+ * in batches, so a deployment can pick its backend:
+ *
+ *	CTokenDb        redis, shared by all hosts, read-write
+ *	CMemTokenStore  process memory, no network, read-write
+ *	CTokenFile      mmap()ed export of a store, read-only
+ */
+class CTokenStore
+{
+public:
+	virtual ~CTokenStore() {}
+
+	/* words[i] is the record of tokens[i], found[i] is false if unknown */
+	virtual bool Lookup(const vector<string>& tokens,vector<b_word_t>& words,vector<bool>& found) = 0;
+
+	/* add deltas[i] to tokens[i]. counters never drop below 0 and a
+	 * negative delta never creates a token */
+	virtual bool Add(const vector<string>& tokens,const vector<b_word_t>& deltas) = 0;
+
+	/* same delta for every token */
+	bool Add(const vector<string>& tokens,const int dbad,const int dgood)
+	{
+		b_word_t delta = {dbad,dgood};
+		return Add(tokens,vector<b_word_t>(tokens.size(),delta));
+	}
+
+	virtual string getError() = 0;
+
+	/* the store is keyed by CTokenKey::hashToken(token), callers must
+	 * translate tokens before Lookup() and Add() */
+	virtual bool isHashed() { return false; }
+};
+
+#endif /*CTOKENSTORE_H*/
@@ -1,8 +1,11 @@
 #include "Common.h"
 
 #include <errno.h>
+#include <iconv.h>
+#include <arpa/inet.h>
 
 #include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -164,3 +167,58 @@ string format_to_check(const string to_check,const string charset)
 
 	return ret;
 }
+
+static bool read_all(int fd,char* buf,size_t len,volatile sig_atomic_t* stop)
+{
+	while (len > 0)
+	{
+		ssize_t n = read(fd,buf,len);
+		if (n < 0 && stop != NULL && *stop) return false;
+		if (n < 0 && errno == EINTR) continue;
+		/* a receive timeout is only there to look at stop */
+		if (n < 0 && stop != NULL && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+		if (n <= 0) return false;
+
+		buf += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+static bool write_all(int fd,const char* buf,size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd,buf,len);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+
+		buf += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+bool read_frame(int fd,string& data,const unsigned int maxlen,volatile sig_atomic_t* stop)
+{
+	uint32_t len = 0;
+	if (!read_all(fd,(char*)&len,sizeof(len),stop)) return false;
+
+	len = ntohl(len);
+	if (len > maxlen) return false;
+
+	data.resize(len);
+	if (len == 0) return true;
+
+	return read_all(fd,&data[0],len,stop);
+}
+
+bool write_frame(int fd,const string& data)
+{
+	uint32_t len = htonl((uint32_t)data.size());
+	if (!write_all(fd,(const char*)&len,sizeof(len))) return false;
+
+	return write_all(fd,data.data(),data.size());
+}
@@ -1,6 +1,8 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <signal.h>
+
 #include <sstream>
 using std::stringstream;
 
@@ -14,4 +16,12 @@ string delete_special_str( string tmp_str, const char* special_str );
 string get_text_from_html(const char* tmp_html);
 string format_to_check(const string to_check,const string charset);
 
+/* length-prefixed frames: 4 bytes network order length + data. With
+ * stop, read_frame() gives up once *stop is set instead of retrying an
+ * interrupted read; give the socket an SO_RCVTIMEO so a signal that
+ * comes just before read() blocks is noticed too */
+bool read_frame(int fd,string& data,const unsigned int maxlen,
+	volatile sig_atomic_t* stop = NULL);
+bool write_frame(int fd,const string& data);
+
 #endif /*COMMON_H*/
@@ -0,0 +1,116 @@
+#include "Hash.h"
+
+#include <string.h>
+
+static const uint64_t PRIME64_1 = 11400714785074694791ULL;
+static const uint64_t PRIME64_2 = 14029467366897019727ULL;
+static const uint64_t PRIME64_3 = 1609587929392839161ULL;
+static const uint64_t PRIME64_4 = 9650029242287828579ULL;
+static const uint64_t PRIME64_5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl64(uint64_t x,int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+/* little endian loads, memcpy keeps unaligned access legal */
+static inline uint64_t read64(const unsigned char* p)
+{
+	uint64_t v;
+	memcpy(&v,p,sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline uint32_t read32(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v,p,sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline uint64_t round64(uint64_t acc,uint64_t input)
+{
+	acc += input * PRIME64_2;
+	acc = rotl64(acc,31);
+	acc *= PRIME64_1;
+	return acc;
+}
+
+static inline uint64_t merge64(uint64_t acc,uint64_t val)
+{
+	val = round64(0,val);
+	acc ^= val;
+	acc = acc * PRIME64_1 + PRIME64_4;
+	return acc;
+}
+
+uint64_t hash64(const void* data,const size_t len,const uint64_t seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + len;
+	uint64_t h;
+
+	if (len >= 32)
+	{
+		const unsigned char* limit = end - 32;
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+
+		do
+		{
+			v1 = round64(v1,read64(p)); p += 8;
+			v2 = round64(v2,read64(p)); p += 8;
+			v3 = round64(v3,read64(p)); p += 8;
+			v4 = round64(v4,read64(p)); p += 8;
+		} while (p <= limit);
+
+		h = rotl64(v1,1) + rotl64(v2,7) + rotl64(v3,12) + rotl64(v4,18);
+		h = merge64(h,v1);
+		h = merge64(h,v2);
+		h = merge64(h,v3);
+		h = merge64(h,v4);
+	}
+	else
+	{
+		h = seed + PRIME64_5;
+	}
+
+	h += (uint64_t)len;
+
+	while (p + 8 <= end)
+	{
+		h ^= round64(0,read64(p));
+		h = rotl64(h,27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+
+	if (p + 4 <= end)
+	{
+		h ^= (uint64_t)read32(p) * PRIME64_1;
+		h = rotl64(h,23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	while (p < end)
+	{
+		h ^= (*p) * PRIME64_5;
+		h = rotl64(h,11) * PRIME64_1;
+		++p;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
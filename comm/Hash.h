@@ -0,0 +1,20 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+using std::string;
+
+/* xxHash64, stable across hosts and releases: never change the seed */
+#define HASH64_SEED 0x5a5a5a5aULL
+
+uint64_t hash64(const void* data,const size_t len,const uint64_t seed = HASH64_SEED);
+
+inline uint64_t hash64(const string& s,const uint64_t seed = HASH64_SEED)
+{
+	return hash64(s.data(),s.size(),seed);
+}
+
+#endif /*HASH_H*/
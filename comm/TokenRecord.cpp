@@ -0,0 +1,83 @@
+#include "TokenRecord.h"
+
+static void put_varint(string& out,unsigned int v)
+{
+	while (v >= 0x80)
+	{
+		out += (char)((v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	out += (char)v;
+}
+
+static bool get_varint(const unsigned char*& p,const unsigned char* end,unsigned int& v)
+{
+	v = 0;
+	for (int shift = 0; p < end && shift < 35; shift += 7)
+	{
+		unsigned char b = *p++;
+		v |= (unsigned int)(b & 0x7f) << shift;
+		if (!(b & 0x80)) return true;
+	}
+
+	return false;
+}
+
+static bool get_decimal(const unsigned char*& p,const unsigned char* end,unsigned int& v)
+{
+	const unsigned char* begin = p;
+	v = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		v = v * 10 + (*p++ - '0');
+	}
+
+	return p != begin;
+}
+
+string encode_record(const b_word_t& word)
+{
+	string out;
+	out.reserve(11);
+	out += (char)TOKEN_RECORD_V1;
+	put_varint(out,word.bad > 0 ? word.bad : 0);
+	put_varint(out,word.good > 0 ? word.good : 0);
+
+	return out;
+}
+
+bool decode_record(const char* data,const size_t len,b_word_t& word)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + len;
+	unsigned int bad = 0;
+	unsigned int good = 0;
+
+	if (len == 0) return false;
+
+	if (*p == TOKEN_RECORD_V1)
+	{
+		++p;
+		if (!get_varint(p,end,bad) || !get_varint(p,end,good)) return false;
+	}
+	else
+	{
+		if (!get_decimal(p,end,bad)) return false;
+		while (p < end && *p == ' ') ++p;
+		if (!get_decimal(p,end,good)) return false;
+	}
+
+	word.bad = (int)bad;
+	word.good = (int)good;
+	return true;
+}
+
+bool decode_record(const string& data,b_word_t& word)
+{
+	return decode_record(data.data(),data.size(),word);
+}
+
+bool is_legacy_record(const string& data)
+{
+	return !data.empty() && data[0] >= '0' && data[0] <= '9';
+}
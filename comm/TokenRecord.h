@@ -0,0 +1,29 @@
+#ifndef TOKENRECORD_H
+#define TOKENRECORD_H
+
+#include <string>
+using std::string;
+
+/* spam/ham counters of one token */
+typedef struct b_word_t_
+{
+	int bad;
+	int good;
+} b_word_t;
+
+/*
+ * value of a token key in the store
+ *
+ *	v1:     0x01 <varint bad> <varint good>	(LEB128, 3..11 bytes)
+ *	legacy: "<bad> <good>"			(ascii, always starts with a digit)
+ *
+ * decode_record() reads both, encode_record() always writes v1.
+ */
+#define TOKEN_RECORD_V1 0x01
+
+string encode_record(const b_word_t& word);
+bool decode_record(const string& data,b_word_t& word);
+bool decode_record(const char* data,const size_t len,b_word_t& word);
+bool is_legacy_record(const string& data);
+
+#endif /*TOKENRECORD_H*/
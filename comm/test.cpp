@@ -1,6 +1,509 @@
+#include "TokenRecord.h"
+#include "CTokenKey.h"
+#include "CMailBox.h"
+#include "CTokenCache.h"
+#include "CTokenFile.h"
+#include "CMemTokenStore.h"
+#include "CBloomFilter.h"
+#include "Hash.h"
+#include "Common.h"
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <fstream>
+using std::ofstream;
+
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
 #include <cstdlib>
+#include <climits>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * test -- checks of the comm classes that need no redis. Every failed
+ * check is printed, the exit status is not 0 if there was one.
+ */
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond),#cond,__FILE__,__LINE__)
+
+static void check(const bool ok,const char* what,const char* file,const int line)
+{
+	if (ok) return;
+
+	cerr << file << ":" << line << ": failed: " << what << endl;
+	++failures;
+}
+
+/* scratch files of a test, removed by remove_scratch() in reverse order */
+static vector<string> scratch;
+
+static string make_dir(const string& path)
+{
+	mkdir(path.c_str(),0700);
+	scratch.push_back(path);
+
+	return path;
+}
+
+static string make_file(const string& path,const string& data)
+{
+	ofstream out(path.c_str(),std::ios::out | std::ios::binary);
+	out << data;
+	scratch.push_back(path);
+
+	return path;
+}
+
+static void remove_scratch()
+{
+	for (size_t i = scratch.size(); i > 0; --i)
+	{
+		if (0 != unlink(scratch[i - 1].c_str())) rmdir(scratch[i - 1].c_str());
+	}
+	scratch.clear();
+}
+
+static string scratch_dir()
+{
+	char dir[] = "/tmp/comm_test.XXXXXX";
+	if (NULL == mkdtemp(dir))
+	{
+		cerr << "can't create " << dir << endl;
+		exit(-1);
+	}
+	scratch.push_back(dir);
+
+	return dir;
+}
+
+static bool same_word(const b_word_t& a,const int bad,const int good)
+{
+	return a.bad == bad && a.good == good;
+}
+
+static void test_record()
+{
+	const int COUNTS[][2] = {{0,0},{1,2},{127,128},{300,70000},{INT_MAX,0}};
+	for (size_t i = 0; i < sizeof(COUNTS) / sizeof(COUNTS[0]); ++i)
+	{
+		b_word_t in = {COUNTS[i][0],COUNTS[i][1]};
+		string data = encode_record(in);
+		b_word_t out = {-1,-1};
+		CHECK(data[0] == TOKEN_RECORD_V1);
+		CHECK(false == is_legacy_record(data));
+		CHECK(decode_record(data,out));
+		CHECK(same_word(out,in.bad,in.good));
+	}
+
+	/* one varint byte per 7 bits */
+	b_word_t small = {0,0};
+	CHECK(encode_record(small).size() == 3);
+	b_word_t wide = {127,128};
+	CHECK(encode_record(wide).size() == 4);
+	b_word_t max = {INT_MAX,INT_MAX};
+	CHECK(encode_record(max).size() == 11);
+
+	/* counters below 0 are stored as 0 */
+	b_word_t negative = {-5,3};
+	b_word_t out = {-1,-1};
+	CHECK(decode_record(encode_record(negative),out));
+	CHECK(same_word(out,0,3));
+
+	/* legacy "<bad> <good>" */
+	CHECK(is_legacy_record("12 34"));
+	CHECK(decode_record("12 34",out));
+	CHECK(same_word(out,12,34));
+	CHECK(decode_record("5  6",out));
+	CHECK(same_word(out,5,6));
+	CHECK(decode_record("0 0",out));
+	CHECK(same_word(out,0,0));
+
+	/* broken records */
+	CHECK(false == decode_record("",out));
+	CHECK(false == decode_record("abc",out));
+	CHECK(false == decode_record("12",out));
+	CHECK(false == decode_record("12 x",out));
+	CHECK(false == decode_record(string("\x01\x80",2),out));
+	CHECK(false == decode_record(string("\x01\x05",2),out));
+	CHECK(false == is_legacy_record(""));
+}
+
+static void test_key()
+{
+	/* one string key per token */
+	CTokenKey keys;
+	CHECK(keys.getLayout() == "buckets=0");
+	CHECK(false == keys.isBucketed());
+	CHECK(keys.key("viagra") == "viagra");
+	CHECK(keys.isTokenKey("viagra"));
+	CHECK(false == keys.isTokenKey(LAYOUT_KEY));
+	CHECK(CTokenKey::isReserved(NAMES_KEY));
+
+	/* buckets */
+	CHECK(keys.setLayout("buckets=16"));
+	CHECK(keys.isBucketed() && keys.getBuckets() == 16 && false == keys.isHashed());
+	CHECK(keys.getLayout() == "buckets=16");
+	string key = keys.key("viagra");
+	CHECK(key.compare(0,7,"bucket ") == 0 && atoi(key.c_str() + 7) < 16);
+	CHECK(key == keys.key("viagra"));
+	CHECK(CTokenKey::isReserved(key));
+	CHECK(keys.bucket(3) == "bucket 3");
+	CHECK(keys.badField("viagra") == "bviagra");
+	CHECK(keys.goodField("viagra") == "gviagra");
+
+	/* hashed */
+	CHECK(keys.setLayout("buckets=0 hashed"));
+	CHECK(false == keys.isBucketed() && keys.isHashed());
+	CHECK(keys.getLayout() == "buckets=0 hashed");
+	string hashed = CTokenKey::hashToken("viagra");
+	CHECK(hashed.size() == HASHED_TOKEN_SIZE);
+	CHECK(hashed == CTokenKey::hashToken("viagra",6));
+	CHECK(hashed != CTokenKey::hashToken("viagr"));
+	CHECK(keys.isTokenKey(hashed));
+	CHECK(false == keys.isTokenKey("viagra"));
+	CHECK(false == keys.isTokenKey(LAYOUT_KEY));
+
+	string hex = CTokenKey::hashToHex(hashed);
+	string back;
+	CHECK(hex.size() == 2 * HASHED_TOKEN_SIZE);
+	CHECK(CTokenKey::hexToHash(hex,back) && back == hashed);
+	CHECK(false == CTokenKey::hexToHash("viagra",back));
+	CHECK(false == CTokenKey::hexToHash("0123456789abcdeg",back));
+
+	/* "" is the default, anything else is an error that keeps the layout */
+	CHECK(false == keys.setLayout("buckets=4 sorted"));
+	CHECK(false == keys.setLayout("hashed"));
+	CHECK(keys.getLayout() == "buckets=0 hashed");
+	CHECK(keys.setLayout(""));
+	CHECK(keys.getLayout() == "buckets=0");
+}
+
+static void test_mailbox()
+{
+	const string dir = scratch_dir();
+	CMailBox box;
+	string name;
+	string data;
+
+	/* mbox: the "From " lines separate, they are not part of a message */
+	const string mbox = make_file(dir + "/mbox",
+		"From a@example.com Mon Jan  1 00:00:00 2024\n"
+		"Subject: one\n\nfirst body\n\n"
+		"From b@example.com Mon Jan  1 00:00:01 2024\n"
+		"Subject: two\n\nsecond body\nFrom: is a header, no separator\n");
+	CHECK(box.Open(mbox));
+	CHECK(box.Next(name,data));
+	CHECK(name == mbox + ":1");
+	CHECK(data == "Subject: one\n\nfirst body\n\n");
+	CHECK(box.Next(name,data));
+	CHECK(name == mbox + ":2");
+	CHECK(data == "Subject: two\n\nsecond body\nFrom: is a header, no separator\n");
+	CHECK(false == box.Next(name,data));
+
+	/* an empty message is skipped but keeps its number, mboxrd ">From "
+	 * lines lose one '>' */
+	const string mboxrd = make_file(dir + "/mboxrd",
+		"From a@example.com Mon Jan  1 00:00:00 2024\n"
+		"\n"
+		"From b@example.com Mon Jan  1 00:00:01 2024\n"
+		"Subject: two\n\n>From here\n>>From there\n> From nowhere\n\n"
+		"From c@example.com Mon Jan  1 00:00:02 2024\n"
+		"From d@example.com Mon Jan  1 00:00:03 2024\n"
+		"Subject: four\n");
+	CHECK(box.Open(mboxrd));
+	CHECK(box.Next(name,data));
+	CHECK(name == mboxrd + ":2");
+	CHECK(data == "Subject: two\n\nFrom here\n>From there\n> From nowhere\n\n");
+	CHECK(box.Next(name,data));
+	CHECK(name == mboxrd + ":4");
+	CHECK(data == "Subject: four\n");
+	CHECK(false == box.Next(name,data));
+
+	/* Maildir: cur/ then new/, sorted, tmp/ and dot files are skipped */
+	const string maildir = make_dir(dir + "/Maildir");
+	make_dir(maildir + "/tmp");
+	make_dir(maildir + "/cur");
+	make_dir(maildir + "/new");
+	make_file(maildir + "/tmp/0","half written");
+	make_file(maildir + "/cur/2","Subject: cur 2\n");
+	make_file(maildir + "/cur/1","Subject: cur 1\n");
+	make_file(maildir + "/cur/.hidden","hidden");
+	make_file(maildir + "/new/1","Subject: new 1\n");
+	CHECK(box.Open(maildir));
+	CHECK(box.Next(name,data) && name == maildir + "/cur/1" && data == "Subject: cur 1\n");
+	CHECK(box.Next(name,data) && name == maildir + "/cur/2" && data == "Subject: cur 2\n");
+	CHECK(box.Next(name,data) && name == maildir + "/new/1" && data == "Subject: new 1\n");
+	CHECK(false == box.Next(name,data));
+
+	/* a plain directory, every file is a message */
+	CHECK(box.Open(maildir + "/tmp"));
+	CHECK(box.Next(name,data) && data == "half written");
+	CHECK(false == box.Next(name,data));
+
+	CHECK(false == box.Open(dir + "/missing"));
+	CHECK(box.getError() != "");
+
+	box.Close();
+	remove_scratch();
+}
+
+/* n tokens that land in shard of a CTokenCache */
+static vector<string> same_shard(const size_t n,const unsigned int shard)
+{
+	vector<string> tokens;
+	for (int i = 0; tokens.size() < n; ++i)
+	{
+		string token = "token" + my_int2str(i);
+		if (hash64(token) % 16 == shard) tokens.push_back(token);
+	}
+
+	return tokens;
+}
+
+static void test_cache()
+{
+	vector<b_word_t> words;
+	vector<bool> found;
+	vector<size_t> missing;
+
+	/* 16 shards of one entry each */
+	CTokenCache cache(16,300);
+	CHECK(cache.getCapacity() == 16);
+
+	vector<string> tokens = same_shard(2,0);
+	tokens.push_back(same_shard(1,1)[0]);
+	cache.Lookup(tokens,words,found,missing);
+	CHECK(missing.size() == 3 && cache.getMisses() == 3 && cache.getSize() == 0);
+
+	/* unknown tokens are cached as well */
+	vector<b_word_t> answer(3);
+	answer[0].bad = 1; answer[0].good = 2;
+	answer[1].bad = 3; answer[1].good = 4;
+	answer[2].bad = 0; answer[2].good = 0;
+	vector<bool> known(3,true);
+	known[2] = false;
+	vector<size_t> first(1,0);
+	vector<size_t> last(1,2);
+	cache.Store(tokens,first,answer,known);
+	cache.Store(tokens,last,answer,known);
+	cache.Lookup(tokens,words,found,missing);
+	CHECK(missing.size() == 1 && missing[0] == 1);
+	CHECK(found[0] && same_word(words[0],1,2));
+	CHECK(false == found[2] && cache.getHits() == 2);
+
+	/* the second token of the shard pushes out the first */
+	vector<size_t> second(1,1);
+	cache.Store(tokens,second,answer,known);
+	cache.Lookup(tokens,words,found,missing);
+	CHECK(missing.size() == 1 && missing[0] == 0);
+	CHECK(found[1] && same_word(words[1],3,4));
+	CHECK(cache.getSize() == 2);
+
+	cache.Clear();
+	CHECK(cache.getSize() == 0);
+
+	/* a ttl of 0 expires at once */
+	CTokenCache expired(16,0);
+	expired.Store(tokens,first,answer,known);
+	expired.Lookup(tokens,words,found,missing);
+	CHECK(missing.size() == 3 && false == found[0]);
+}
+
+static void test_token_file()
+{
+	const string dir = scratch_dir();
+	const string path = dir + "/tokens";
+	scratch.push_back(path);
+
+	/* enough tokens to grow the table past its 16 slots */
+	vector<string> tokens;
+	vector<b_word_t> words;
+	for (int i = 0; i < 100; ++i)
+	{
+		b_word_t word = {i,2 * i};
+		tokens.push_back("token" + my_int2str(i));
+		words.push_back(word);
+	}
+	/* a duplicate keeps the first record */
+	b_word_t dup = {-1,-1};
+	tokens.push_back("token7");
+	words.push_back(dup);
+
+	string error;
+	CHECK(CTokenFile::Write(path,tokens,words,false,error));
+	CHECK(0 != access((path + ".tmp").c_str(),F_OK));
+
+	CTokenFile file;
+	CHECK(false == file.isOpen());
+	CHECK(file.Open(path));
+	CHECK(file.isOpen() && file.getSize() == 100 && false == file.isHashed());
+
+	b_word_t word = {-1,-1};
+	CHECK(file.Find("token0",word) && same_word(word,0,0));
+	CHECK(file.Find("token7",word) && same_word(word,7,14));
+	CHECK(file.Find("token99",word) && same_word(word,99,198));
+	CHECK(false == file.Find("token100",word));
+	CHECK(false == file.Find("",word));
+
+	vector<string> lookup;
+	lookup.push_back("token42");
+	lookup.push_back("missing");
+	vector<b_word_t> foundWords;
+	vector<bool> found;
+	CHECK(file.Lookup(lookup,foundWords,found));
+	CHECK(found[0] && same_word(foundWords[0],42,84));
+	CHECK(false == found[1] && same_word(foundWords[1],0,0));
+	CHECK(false == file.Add(lookup,1,0));
+
+	vector<string> all;
+	vector<b_word_t> allWords;
+	file.getAll(all,allWords);
+	CHECK(all.size() == 100 && allWords.size() == 100);
+
+	/* hashed flag, an empty file */
+	vector<string> none;
+	vector<b_word_t> noWords;
+	CHECK(CTokenFile::Write(path,none,noWords,true,error));
+	CHECK(file.Open(path));
+	CHECK(file.getSize() == 0 && file.isHashed());
+	CHECK(false == file.Find("token0",word));
+
+	/* no token file */
+	make_file(dir + "/junk","not a token file at all, just some text");
+	CHECK(false == file.Open(dir + "/junk"));
+	CHECK(false == file.isOpen() && file.getError() != "");
+	CHECK(false == file.Open(dir + "/missing"));
+
+	file.Close();
+	remove_scratch();
+}
+
+static void test_mem_store()
+{
+	CMemTokenStore store;
+	vector<string> tokens;
+	tokens.push_back("viagra");
+	tokens.push_back("hello");
+	vector<b_word_t> words;
+	vector<bool> found;
+
+	CHECK(store.Add(tokens,5,5));
+	CHECK(store.getSize() == 2);
+
+	/* counters stop at 0 */
+	vector<b_word_t> deltas(2);
+	deltas[0].bad = -10; deltas[0].good = 2;
+	deltas[1].bad = 1; deltas[1].good = -1;
+	CHECK(store.Add(tokens,deltas));
+	CHECK(store.Lookup(tokens,words,found));
+	CHECK(found[0] && same_word(words[0],0,7));
+	CHECK(found[1] && same_word(words[1],6,4));
+
+	/* a negative delta never creates a token */
+	vector<string> unknown(1,"unknown");
+	CHECK(store.Add(unknown,-1,0));
+	CHECK(store.Add(unknown,0,-1));
+	CHECK(store.getSize() == 2);
+	CHECK(store.Lookup(unknown,words,found));
+	CHECK(false == found[0] && same_word(words[0],0,0));
+
+	/* Load() replaces everything */
+	b_word_t word = {3,4};
+	store.Load(unknown,vector<b_word_t>(1,word),true);
+	CHECK(store.getSize() == 1 && store.isHashed());
+	CHECK(store.Lookup(tokens,words,found));
+	CHECK(false == found[0] && false == found[1]);
+	CHECK(store.Lookup(unknown,words,found));
+	CHECK(found[0] && same_word(words[0],3,4));
+}
+
+static void test_bloom()
+{
+	/* no filter lets everything through */
+	CBloomFilter bloom;
+	CHECK(bloom.isEmpty() && bloom.mayContain("anything"));
+
+	bloom.Init(1000);
+	CHECK(false == bloom.isEmpty());
+	CHECK(bloom.getParams() == "bits=10000 hashes=7");
+	CHECK(bloom.getBitmap().size() == 1250);
+
+	vector<uint64_t> bits;
+	bloom.getBits("token0",bits);
+	CHECK(bits.size() == 7);
+	for (size_t i = 0; i < bits.size(); ++i)
+	{
+		CHECK(bits[i] < 10000);
+	}
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		bloom.Add("token" + my_int2str(i));
+	}
+
+	/* SETBIT order: bit 0 is the high bit of byte 0 */
+	for (size_t i = 0; i < bits.size(); ++i)
+	{
+		CHECK((unsigned char)bloom.getBitmap()[bits[i] >> 3] & (0x80 >> (bits[i] & 7)));
+	}
+
+	int missed = 0;
+	int falsePositives = 0;
+	for (int i = 0; i < 10000; ++i)
+	{
+		if (i < 1000 && false == bloom.mayContain("token" + my_int2str(i))) ++missed;
+		if (bloom.mayContain("other" + my_int2str(i))) ++falsePositives;
+	}
+	CHECK(missed == 0);
+	/* about 1% at 10 bits per token */
+	CHECK(falsePositives < 300);
+
+	/* as read back from redis, which drops trailing zero bytes */
+	CBloomFilter copy;
+	CHECK(copy.setParams(bloom.getParams()));
+	string bitmap = bloom.getBitmap();
+	while (bitmap != "" && bitmap[bitmap.size() - 1] == '\0') bitmap.resize(bitmap.size() - 1);
+	copy.setBitmap(bitmap);
+	for (int i = 0; i < 1000; ++i)
+	{
+		string token = "token" + my_int2str(i);
+		if (false == copy.mayContain(token)) ++missed;
+		if (copy.mayContain("other" + token) != bloom.mayContain("other" + token)) ++missed;
+	}
+	CHECK(missed == 0);
+
+	CHECK(false == copy.setParams("bits=0 hashes=7"));
+	CHECK(false == copy.setParams("bits=100 hashes=0"));
+	CHECK(false == copy.setParams(""));
+}
 
 int main(int argc,char* argv[])
 {
+	test_record();
+	test_key();
+	test_mailbox();
+	test_cache();
+	test_token_file();
+	test_mem_store();
+	test_bloom();
+
+	if (failures > 0)
+	{
+		cerr << failures << " checks failed" << endl;
+		exit(-1);
+	}
+
+	cout << "all checks passed" << endl;
 	exit(0);
 }
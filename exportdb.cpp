@@ -0,0 +1,84 @@
+#include "comm/CTokenFile.h"
+#include "CRedis.h"
+#include "CTokenDb.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+using namespace std;
+
+/*
+ * exportdb -- write the token store into one read-only file (see
+ * comm/CTokenFile.h) for scanners that run without redis:
+ *
+ *	exportdb tokens.db && antispamd -f tokens.db
+ *
+ * The file is replaced atomically, running scanners reopen it on restart.
+ */
+int main(int argc,char* argv[])
+{
+	string redisIp = "127.0.0.1";
+	int redisPort = 6379;
+	string redisSocket = "";
+
+	int opt;
+	while ((opt = getopt(argc,argv,"r:p:u:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'r': redisIp = optarg; break;
+			case 'p': redisPort = atoi(optarg); break;
+			case 'u': redisSocket = optarg; break;
+			default: optind = argc + 1;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		cerr << "Usage: " << argv[0] << " [-r redis_ip] [-p redis_port] [-u redis_socket] <file>" << endl;
+		exit(-1);
+	}
+
+	CRedis myRedis(redisIp,redisPort);
+	const int CONNECT_TIMEOUT = 1;
+	myRedis.setTimeout(CONNECT_TIMEOUT);
+	if (redisSocket != "") myRedis.setUnixSocket(redisSocket);
+	if (false == myRedis.Connect())
+	{
+		cerr << myRedis.getError() << endl;
+		return -1;
+	}
+
+	CTokenDb myTokens(myRedis);
+	vector<string> tokens;
+	vector<b_word_t> words;
+	vector<string> keys;
+	vector<b_word_t> values;
+	string cursor = "0";
+	do
+	{
+		if (false == myTokens.Scan(cursor,keys,values))
+		{
+			cerr << myTokens.getError() << endl;
+			return -1;
+		}
+		tokens.insert(tokens.end(),keys.begin(),keys.end());
+		words.insert(words.end(),values.begin(),values.end());
+	} while (cursor != "0");
+
+	bool hashed = myTokens.isHashed();
+	myRedis.Close();
+
+	string error;
+	if (false == CTokenFile::Write(argv[optind],tokens,words,hashed,error))
+	{
+		cerr << error << endl;
+		return -1;
+	}
+
+	cout << "exported " << tokens.size() << " tokens to " << argv[optind] << endl;
+	exit(0);
+}
@@ -1,9 +1,13 @@
 #include "mime/MimeMessage.h"
 #include "mime/String.h"
 #include "fenci/CFenci.h"
+#include "fenci/TextScan.h"
 #include "comm/Common.h"
-#include "comm/CDataParse.h"
+#include "comm/TokenRecord.h"
+#include "comm/CMailBox.h"
 #include "CRedis.h"
+#include "CTokenDb.h"
+#include "MailText.h"
 #include <map>
 #include <string>
 #include <cstdlib>
@@ -11,6 +15,7 @@
 #include <iostream>
 #include <vector>
 #include <set>
+#include <tr1/unordered_map>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -19,6 +24,8 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
 
 using namespace std;
 using namespace fast;
@@ -30,157 +37,339 @@ FastString get_file_content(const string filename);
 #define UN_FEED_SPAM 3
 #define UN_FEED_HAM 4
 
-int main(int argc,char* argv[])
+/* bulk mode: flush once this many distinct tokens are pending */
+const size_t FLUSH_TOKENS = 1000000;
+/* tokens per CTokenStore::Add call while flushing */
+const size_t FLUSH_BATCH = 20000;
+
+typedef tr1::unordered_map<string,int> token_counts_t;
+/* hashToken() -> token, for the side table of a hashed store */
+typedef tr1::unordered_map<string,string> token_names_t;
+
+static void usage(const char* prog)
 {
-	if (argc != 3)
+	cerr << "Usage: " << prog << " [-B buckets] [-H] [-L] [-Z case,width,digits] [--names] [--bigrams] <-s|-n|-S|-N> <email>" << endl;
+	cerr << "       " << prog << " [-B buckets] [-H] [-L] [-Z case,width,digits] [--names] [--bigrams] [-j threads] <-s|-n|-S|-N> --bulk <dir|mbox>" << endl;
+	cerr << "  -B      create the store with <buckets> hash buckets (0: one key per token)" << endl;
+	cerr << "  -H      create the store keyed by 64 bit token hashes" << endl;
+	cerr << "  -L, --fast-latin split latin text without scws; scan with -L too" << endl;
+	cerr << "  -Z, --normalize fold case, full-width forms and/or digit runs first; scan with the same -Z" << endl;
+	cerr << "  --names record hash -> token of a hashed store, for lexer" << endl;
+	cerr << "  --bigrams feed pairs of neighbouring tokens too, scan with antispamd -2" << endl;
+	cerr << "  --bulk  feed every message of a directory or mbox in one run" << endl;
+	cerr << "  -j      tokenize with <threads> threads in bulk mode" << endl;
+	exit(-1);
+}
+
+/* write the merged deltas in large pipelined batches */
+static bool flush_counts(CTokenStore& myTokens,token_counts_t& counts,const int dbad,const int dgood)
+{
+	vector<string> tokens;
+	vector<b_word_t> deltas;
+	tokens.reserve(FLUSH_BATCH);
+	deltas.reserve(FLUSH_BATCH);
+
+	for (token_counts_t::iterator it = counts.begin(); it != counts.end(); ++it)
 	{
-		cerr << "Usage: " << argv[0] << " <-s|-n|-S|-N> <email>" << endl;
-		exit(-1);
+		b_word_t delta = {dbad * it->second,dgood * it->second};
+		tokens.push_back(it->first);
+		deltas.push_back(delta);
+
+		if (tokens.size() >= FLUSH_BATCH)
+		{
+			if (false == myTokens.Add(tokens,deltas)) return false;
+			tokens.clear();
+			deltas.clear();
+		}
 	}
 
-	int feed_type = 0;
-	if (string(argv[1]) == "-s") feed_type = FEED_SPAM;
-	else if (string(argv[1]) == "-n") feed_type = FEED_HAM;
-	else if (string(argv[1]) == "-S") feed_type = UN_FEED_SPAM;
-	else if (string(argv[1]) == "-N") feed_type = UN_FEED_HAM;
-	else { cerr << "Usage: " << argv[0] << " <-s|-n|-S|-N> <email>" << endl; exit(-1); }
+	counts.clear();
+	return myTokens.Add(tokens,deltas);
+}
 
-	FastString email_data = get_file_content(argv[2]);
-        MimeMessage msg(email_data);
+/* the side table in large pipelined batches */
+static bool flush_names(CTokenDb& myTokens,token_names_t& names)
+{
+	vector<string> hashed;
+	vector<string> tokens;
+	for (token_names_t::iterator it = names.begin(); it != names.end(); ++it)
+	{
+		hashed.push_back(it->first);
+		tokens.push_back(it->second);
 
-        FastString charset="";
-	FastString plain = "";
-	FastString html = "";
-	FastString subject="";
+		if (hashed.size() >= FLUSH_BATCH)
+		{
+			if (false == myTokens.addNames(hashed,tokens)) return false;
+			hashed.clear();
+			tokens.clear();
+		}
+	}
 
+	names.clear();
+	return myTokens.addNames(hashed,tokens);
+}
 
-	set<string> result;
-	CFenci myFenci;
-	myFenci.setDict("/usr/local/etc/dict_chs.utf8.xdb");
-	myFenci.setRule("/usr/local/etc/rules.utf8.ini");
-	myFenci.setCharset("utf-8");
-	myFenci.setIgnoreSign();
+/* keys of result in the store, and their names if wanted */
+static void store_tokens(const set<string>& result,const bool hashed,
+		vector<string>& keys,token_names_t* names)
+{
+	keys.clear();
+	for (set<string>::const_iterator it = result.begin(); it != result.end(); ++it)
+	{
+		if (!hashed)
+		{
+			keys.push_back(*it);
+			continue;
+		}
 
-	/* parse subject */
-	msg.getSubject(subject,charset);
-	myFenci.getFenciResult(format_to_check(subject.c_str(),charset.c_str()),result);
+		keys.push_back(CTokenKey::hashToken(*it));
+		if (names != NULL) (*names)[keys.back()] = *it;
+	}
+}
 
-	/* parse plain */
-        msg.getTextPlain(plain,charset);
-	myFenci.getFenciResult(format_to_check(subject.c_str(),charset.c_str()),result);	
+/* state shared by the bulk workers: the store behind flushLock, so a
+ * flush doesn't stop the others from reading mail, the rest behind lock */
+typedef struct bulk_t_
+{
+	pthread_mutex_t lock;
+	pthread_mutex_t flushLock;
+	CMailBox* mailbox;
+	CTokenStore* tokens;
+	bool hashed;
+	bool names;
+	bool bigrams;
+	int dbad;
+	int dgood;
+	size_t flushTokens;
+	unsigned long messages;
+	bool failed;
+} bulk_t;
 
-	/* parse html */
-	msg.getTextHtml(html,charset);
-	string html_to_check = get_text_from_html(html.c_str());
-	myFenci.getFenciResult(format_to_check(html_to_check,charset.c_str()),result);
+typedef struct bulk_worker_t_
+{
+	bulk_t* bulk;
+	CFenci* fenci;
+	token_counts_t counts;
+	token_names_t names;
+} bulk_worker_t;
 
-	/* connect redis */
-	CRedis myRedis("127.0.0.1",6379);
-	const int CONNECT_TIMEOUT = 1;
-	myRedis.setTimeout(CONNECT_TIMEOUT);
-	if (false == myRedis.Connect())	
-	{
-		cerr << myRedis.getError() << endl;
-		return -1;
-	}
+/* tokenize with a private scws fork into a private map, no locking on the hot path */
+static void* bulk_worker(void* arg)
+{
+	bulk_worker_t* worker = (bulk_worker_t*)arg;
+	bulk_t* bulk = worker->bulk;
+	string name;
+	string data;
 
-	/* feed spam */
-	if (feed_type == FEED_SPAM)
+	for (;;)
 	{
-		for (set<string>::iterator it = result.begin(); it != result.end(); ++it)
+		pthread_mutex_lock(&bulk->lock);
+		bool more = !bulk->failed && bulk->mailbox->Next(name,data);
+		if (more && ++bulk->messages % 1000 == 0)
+			cerr << "feeding " << bulk->messages << " messages" << endl;
+		pthread_mutex_unlock(&bulk->lock);
+		if (!more) break;
+
+		set<string> result;
+		FastString email_data(data.data(),data.size());
+		get_mail_tokens(*worker->fenci,email_data,result,bulk->bigrams);
+
+		vector<string> keys;
+		store_tokens(result,bulk->hashed,keys,bulk->names ? &worker->names : NULL);
+		for (vector<string>::iterator it = keys.begin(); it != keys.end(); ++it)
 		{
-			string buffer = myRedis.Get(*it);
-			if (buffer != "")
-			{
-				CDataParse myData(buffer," ");
-				vector<string> ret = myData.getVector();
-				ret[0] = my_int2str((my_str2int(ret[0]) + 1));
-				myData.setVector(ret);
-				if (false == myRedis.Set(*it,myData.getString()))
-				{
-					cerr << myRedis.getError() << endl;
-					return -1;
-				}
-			}
-			else
-			{
-				if (false == myRedis.Set(*it,"1 0"))
-				{
-					cerr << myRedis.getError() << endl;
-					return -1;
-				}
-			}
+			++worker->counts[*it];
 		}
+
+		if (worker->counts.size() >= bulk->flushTokens)
+		{
+			pthread_mutex_lock(&bulk->flushLock);
+			bool ok = flush_counts(*bulk->tokens,worker->counts,bulk->dbad,bulk->dgood);
+			string error = ok ? "" : bulk->tokens->getError();
+			pthread_mutex_unlock(&bulk->flushLock);
+			if (ok) continue;
+
+			pthread_mutex_lock(&bulk->lock);
+			cerr << error << endl;
+			bulk->failed = true;
+			pthread_mutex_unlock(&bulk->lock);
+		}
+	}
+
+	return NULL;
+}
+
+static bool feed_bulk(CFenci& myFenci,CTokenDb& myTokens,const string path,
+		const int dbad,const int dgood,const int threads,const bool names,const bool bigrams)
+{
+	CMailBox mailbox;
+	if (false == mailbox.Open(path))
+	{
+		cerr << mailbox.getError() << endl;
+		return false;
+	}
+
+	bulk_t bulk;
+	pthread_mutex_init(&bulk.lock,NULL);
+	pthread_mutex_init(&bulk.flushLock,NULL);
+	bulk.mailbox = &mailbox;
+	bulk.tokens = &myTokens;
+	bulk.hashed = myTokens.isHashed();
+	bulk.names = names && bulk.hashed;
+	bulk.bigrams = bigrams;
+	bulk.dbad = dbad;
+	bulk.dgood = dgood;
+	bulk.flushTokens = FLUSH_TOKENS / threads;
+	bulk.messages = 0;
+	bulk.failed = false;
+
+	vector<bulk_worker_t> workers(threads);
+	vector<pthread_t> tids(threads);
+	for (int i = 0; i < threads; ++i)
+	{
+		workers[i].bulk = &bulk;
+		workers[i].fenci = new CFenci(myFenci);
 	}
 
-	/* feed ham */
-	if (feed_type == FEED_HAM)
+	int started = 0;
+	for (; started < threads; ++started)
 	{
-		for (set<string>::iterator it = result.begin(); it != result.end(); ++it)
+		if (pthread_create(&tids[started],NULL,bulk_worker,&workers[started]) != 0) break;
+	}
+	if (started == 0) bulk_worker(&workers[0]);
+
+	for (int i = 0; i < started; ++i)
+	{
+		pthread_join(tids[i],NULL);
+	}
+
+	/* merge the private maps, then one write phase */
+	token_counts_t& counts = workers[0].counts;
+	token_names_t& allNames = workers[0].names;
+	for (int i = 0; i < threads; ++i)
+	{
+		if (i > 0)
 		{
-			string buffer = myRedis.Get(*it);
-			if (buffer != "")
+			for (token_counts_t::iterator it = workers[i].counts.begin(); it != workers[i].counts.end(); ++it)
 			{
-				CDataParse myData(buffer," ");
-				vector<string> ret = myData.getVector();
-				ret[1] = my_int2str((my_str2int(ret[1]) + 1));
-				myData.setVector(ret);
-				if (false == myRedis.Set(*it,myData.getString()))
-				{
-					cerr << myRedis.getError() << endl;
-					return -1;
-				}
-			}
-			else
-			{
-				if (false == myRedis.Set(*it,"0 1"))
-				{
-					cerr << myRedis.getError() << endl;
-					return -1;
-				}
+				counts[it->first] += it->second;
 			}
+			workers[i].counts.clear();
+			allNames.insert(workers[i].names.begin(),workers[i].names.end());
+			workers[i].names.clear();
 		}
+		delete workers[i].fenci;
 	}
 
-	/* unfeed spam */
-	if (feed_type == UN_FEED_SPAM)
+	bool ok = !bulk.failed;
+	if (ok && (false == flush_counts(myTokens,counts,dbad,dgood) || false == flush_names(myTokens,allNames)))
 	{
-		for (set<string>::iterator it = result.begin(); it != result.end(); ++it)
+		cerr << myTokens.getError() << endl;
+		ok = false;
+	}
+	pthread_mutex_destroy(&bulk.flushLock);
+	pthread_mutex_destroy(&bulk.lock);
+
+	if (ok) cerr << "fed " << bulk.messages << " messages with " << threads << " threads" << endl;
+	return ok;
+}
+
+int main(int argc,char* argv[])
+{
+	int feed_type = -1;
+	int buckets = -1;
+	bool hashed = false;
+	bool names = false;
+	bool bigrams = false;
+	bool fastLatin = false;
+	int normFlags = 0;
+	bool bulk = false;
+	int threads = 1;
+
+	static struct option longopts[] =
+	{
+		{"bulk",no_argument,NULL,'b'},
+		{"names",no_argument,NULL,'a'},
+		{"bigrams",no_argument,NULL,'g'},
+		{"fast-latin",no_argument,NULL,'L'},
+		{"normalize",required_argument,NULL,'Z'},
+		{NULL,0,NULL,0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc,argv,"snSNB:HLZ:j:",longopts,NULL)) != -1)
+	{
+		switch (opt)
 		{
-			string buffer = myRedis.Get(*it);
-			if (buffer != "")
-			{
-				CDataParse myData(buffer," ");
-				vector<string> ret = myData.getVector();
-				if (my_str2int(ret[0]) > 0) ret[0] = my_int2str(my_str2int(ret[0]) - 1);
-				myData.setVector(ret);
-				if (false == myRedis.Set(*it,myData.getString()))
-				{
-					cerr << myRedis.getError() << endl;
-					return -1;
-				}
-			}
+			case 's': feed_type = FEED_SPAM; break;
+			case 'n': feed_type = FEED_HAM; break;
+			case 'S': feed_type = UN_FEED_SPAM; break;
+			case 'N': feed_type = UN_FEED_HAM; break;
+			case 'B': buckets = atoi(optarg); break;
+			case 'H': hashed = true; break;
+			case 'a': names = true; break;
+			case 'g': bigrams = true; break;
+			case 'L': fastLatin = true; break;
+			case 'Z': if (false == parse_normalize(optarg,normFlags)) usage(argv[0]); break;
+			case 'b': bulk = true; break;
+			case 'j': threads = atoi(optarg); break;
+			default: usage(argv[0]);
 		}
 	}
 
-	/* unfeed ham */
-	if (feed_type == UN_FEED_HAM)
+	if (feed_type < 0 || optind != argc - 1 || threads <= 0) usage(argv[0]);
+
+	/* forks read the dict concurrently, so load it in memory for them */
+	CFenci myFenci;
+	myFenci.setDict("/usr/local/etc/dict_chs.utf8.xdb",bulk && threads > 1);
+	myFenci.setRule("/usr/local/etc/rules.utf8.ini");
+	myFenci.setCharset("utf-8");
+	myFenci.setIgnoreSign();
+	myFenci.setFastLatin(fastLatin);
+	myFenci.setNormalize(normFlags);
+
+	/* connect redis */
+	CRedis myRedis("127.0.0.1",6379);
+	const int CONNECT_TIMEOUT = 1;
+	myRedis.setTimeout(CONNECT_TIMEOUT);
+	if (false == myRedis.Connect())	
+	{
+		cerr << myRedis.getError() << endl;
+		return -1;
+	}
+
+	CTokenDb myTokens(myRedis);
+	if ((buckets >= 0 || hashed) && false == myTokens.initLayout(buckets > 0 ? buckets : 0,hashed))
 	{
-		for (set<string>::iterator it = result.begin(); it != result.end(); ++it)
+		cerr << myTokens.getError() << endl;
+		return -1;
+	}
+
+	/* feed or unfeed every token */
+	int dbad = 0;
+	int dgood = 0;
+	if (feed_type == FEED_SPAM) dbad = 1;
+	else if (feed_type == FEED_HAM) dgood = 1;
+	else if (feed_type == UN_FEED_SPAM) dbad = -1;
+	else if (feed_type == UN_FEED_HAM) dgood = -1;
+
+	if (bulk)
+	{
+		if (false == feed_bulk(myFenci,myTokens,argv[optind],dbad,dgood,threads,names,bigrams)) return -1;
+	}
+	else
+	{
+		set<string> result;
+		FastString email_data = get_file_content(argv[optind]);
+		get_mail_tokens(myFenci,email_data,result,bigrams);
+
+		token_names_t tokenNames;
+		vector<string> tokens;
+		store_tokens(result,myTokens.isHashed(),tokens,names ? &tokenNames : NULL);
+		if (false == myTokens.Add(tokens,dbad,dgood) || false == flush_names(myTokens,tokenNames))
 		{
-			string buffer = myRedis.Get(*it);
-			if (buffer != "")
-			{
-				CDataParse myData(buffer," ");
-				vector<string> ret = myData.getVector();
-				if (my_str2int(ret[1]) > 0) ret[1] = my_int2str(my_str2int(ret[1]) - 1);
-				myData.setVector(ret);
-				if (false == myRedis.Set(*it,myData.getString()))
-				{
-					cerr << myRedis.getError() << endl;
-					return -1;
-				}
-			}
+			cerr << myTokens.getError() << endl;
+			return -1;
 		}
 	}
 
@@ -1,17 +1,6 @@
 #!/bin/bash
 
-[ $# -ne 1 ] && { echo "Usage: $0 <dir>"; exit; }
+[ $# -ne 1 ] && { echo "Usage: $0 <dir|mbox>"; exit; }
 
-OLDIFS=$IFS
-IFS=$'\n'
-
-
-cd $1
-for file in `ls`
-do
-	echo "feeding $file ..."
-	/home/dep/AntispamServer/feed -n $file
-done
-
-cd ..
-IFS=$OLDIFS
+echo "feeding $1 ..."
+/home/dep/AntispamServer/feed -n --bulk "$1"
@@ -1,4 +1,7 @@
 #include "CFenci.h"
+#include "TextScan.h"
+
+#include <strings.h>
 
 
 #include <iostream>
@@ -6,7 +9,14 @@ using std::cerr;
 using std::endl;
 using std::cout;
 
-CFenci::CFenci()
+/* feedText() parses every STREAM_CHUNK bytes; the last STREAM_OVERLAP of
+ * them are parsed again with the next piece, so tokens near the cut see
+ * what follows them */
+const size_t STREAM_CHUNK = 64 * 1024;
+const size_t STREAM_OVERLAP = 256;
+
+CFenci::CFenci() : sf(NULL),ignoreSign(false),fastLatin(false),utf8(false),
+	normFlags(0),normDigits(false),normEnd(0)
 {
 	/* create the scws engine */
 	if (!(s = scws_new()))
@@ -14,25 +24,53 @@ CFenci::CFenci()
     		cerr << "ERROR: cann't init the scws!" << endl;
 		exit(-1);
 	}
+	reFork();
+}
+
+CFenci::CFenci(const CFenci& parent) : sf(NULL),
+	ignoreSign(parent.ignoreSign),fastLatin(parent.fastLatin),utf8(parent.utf8),
+	normFlags(parent.normFlags),normDigits(false),normEnd(0)
+{
+	if (!(s = scws_fork(parent.s)))
+	{
+    		cerr << "ERROR: cann't fork the scws!" << endl;
+		exit(-1);
+	}
+	reFork();
 }
 
 CFenci::~CFenci()
 {
-	if (!s) scws_free(s);
+	if (sf) scws_free(sf);
+	if (s) scws_free(s);
+}
+
+scws_t CFenci::getFork()
+{
+	return sf;
 }
 
-bool CFenci::setDict(const string dictFile)
+/* settings of s reach the parser with a new fork */
+void CFenci::reFork()
+{
+	if (sf != NULL) scws_free(sf);
+	sf = scws_fork(s);
+}
+
+bool CFenci::setDict(const string dictFile,const bool inMemory)
 {
 	/* set dict */
-  	scws_set_dict(s, dictFile.c_str(), SCWS_XDICT_XDB);
-	
-	return true;
+  	bool ok = scws_set_dict(s, dictFile.c_str(), inMemory ? (SCWS_XDICT_XDB | SCWS_XDICT_MEM) : SCWS_XDICT_XDB) == 0;
+	reFork();
+
+	return ok;
 }
 
 bool CFenci::setRule(const string ruleFile)
 {
 	/* set rule */
   	scws_set_rule(s, ruleFile.c_str());
+	reFork();
 
 	return true;
 }
@@ -41,6 +79,8 @@ bool CFenci::setCharset(const string charset)
 {
 	/* set charset */
 	scws_set_charset(s, charset.c_str());
+	utf8 = (strcasecmp(charset.c_str(),"utf-8") == 0 || strcasecmp(charset.c_str(),"utf8") == 0);
+	reFork();
 
 	return true;
 }
@@ -49,21 +89,44 @@ bool CFenci::setIgnoreSign()
 {
 	/* set ignore sign */
 	scws_set_ignore(s,1);
+	ignoreSign = true;
+	reFork();
 
 	return true;	
 }
 
-bool CFenci::getFenciResult(const string strToParse,set<string>& result)
+void CFenci::setFastLatin(const bool on)
 {
-	scws_res_t res, cur;
+	fastLatin = on;
+}
+
+void CFenci::setNormalize(const int flags)
+{
+	normFlags = flags;
+}
+
+/* other charsets have ascii bytes inside their characters */
+const string& CFenci::normalize(const string& text)
+{
+	if (!utf8 || normFlags == 0 || text.empty()) return text;
+
+	bool digits = false;
+	normText = text;
+	normText.resize(normalize_text(&normText[0],normText.size(),normFlags,digits));
+
+	return normText;
+}
 
-	const char* str = strToParse.c_str();
-	int str_len = strToParse.size();
+/* one scws pass over str[begin,end), every token goes to sink(str,off,len) */
+template <class SINK>
+static bool fenci_parse(scws_t sf,const char* str,const size_t begin,const size_t end,SINK& sink)
+{
+	scws_res_t res, cur;
 
-	/* fork*/
-	scws_t sf = scws_fork(s);
+	str += begin;
+	int str_len = end - begin;
 
-	/* set text to parse */
+	/* set text to parse, replaces what the fork parsed before */
 	scws_send_text(sf, str, str_len);
 
 	/* loop get words */
@@ -74,8 +137,7 @@ bool CFenci::getFenciResult(const string strToParse,set<string>& result)
 			if (cur->len != 1 || ((*(str + cur->off) != '\n')	
 				&& (*(str + cur->off) != '\r')))
 			{
-				string buff(str + cur->off,cur->len);
-				result.insert(buff);
+				sink(str - begin,begin + cur->off,cur->len);
 			}
 			cur = cur->next;									
 		}												
@@ -83,6 +145,195 @@ bool CFenci::getFenciResult(const string strToParse,set<string>& result)
 		scws_free_result(res);									
 	}
 
-	scws_free(sf);
 	return true;
 }
+
+static inline bool is_space(const char c)
+{
+	return (unsigned char)c <= ' ';
+}
+
+/*
+ * text without wide characters is split by split_latin(), scws only gets
+ * the space delimited chunks that have one, whole, because the dict has
+ * words like "T恤" and "卡拉OK". Neighbouring such chunks go in one pass.
+ */
+template <class SINK>
+static bool fenci_split(scws_t sf,const string& strToParse,const bool signs,
+		vector<token_span_t>& words,SINK& sink)
+{
+	const char* str = strToParse.data();
+	const size_t len = strToParse.size();
+
+	size_t pos = 0;
+	size_t wide = find_wide(str,0,len);
+	while (pos < len)
+	{
+		if (wide >= len)
+		{
+			split_latin(str,pos,len,signs,words);
+			for (size_t i = 0; i < words.size(); ++i) sink(str,words[i].off,words[i].len);
+			break;
+		}
+
+		size_t begin = wide;
+		while (begin > pos && !is_space(str[begin - 1])) --begin;
+
+		split_latin(str,pos,begin,signs,words);
+		for (size_t i = 0; i < words.size(); ++i) sink(str,words[i].off,words[i].len);
+
+		size_t end = wide;
+		for (;;)
+		{
+			while (end < len && !is_space(str[end])) ++end;
+			wide = find_wide(str,end,len);
+			if (wide >= len) break;
+
+			/* is the next wide character in the next chunk */
+			size_t next = end;
+			while (next < wide && is_space(str[next])) ++next;
+			while (next < wide && !is_space(str[next])) ++next;
+			if (next < wide) break;
+			end = wide;
+		}
+
+		if (false == fenci_parse(sf,str,begin,end,sink)) return false;
+		pos = end;
+	}
+
+	return true;
+}
+
+struct set_sink
+{
+	set<string>& result;
+	set_sink(set<string>& result_) : result(result_) {}
+	void operator()(const char* str,const int off,const int len) { result.insert(string(str + off,len)); }
+};
+
+/* tokens are spans of the copy of the text at base in result */
+struct span_sink
+{
+	CTokenIntern& result;
+	size_t base;
+	span_sink(CTokenIntern& result_,const size_t base_) : result(result_),base(base_) {}
+	void operator()(const char*,const int off,const int len) { result.addSpan(base + off,len); }
+};
+
+/* tokens that end before cut go to result, copied; dropped is where the
+ * first one that does not starts */
+struct cut_sink
+{
+	CTokenIntern& result;
+	size_t cut;
+	size_t dropped;
+	cut_sink(CTokenIntern& result_,const size_t cut_) : result(result_),cut(cut_),dropped(cut_) {}
+	void operator()(const char* str,const int off,const int len)
+	{
+		if (off + (size_t)len <= cut) result.Add(str + off,len);
+		else if ((size_t)off < dropped) dropped = off;
+	}
+};
+
+bool CFenci::getFenciResult(const string strToParse,set<string>& result)
+{
+	scws_t sf = getFork();
+	if (sf == NULL) return false;
+
+	const string& text = normalize(strToParse);
+	set_sink sink(result);
+	if (fastLatin && utf8) return fenci_split(sf,text,!ignoreSign,latin,sink);
+	return fenci_parse(sf,text.data(),0,text.size(),sink);
+}
+
+bool CFenci::getFenciResult(const string& strToParse,CTokenIntern& result)
+{
+	scws_t sf = getFork();
+	if (sf == NULL) return false;
+
+	const string& text = normalize(strToParse);
+	result.Reserve(text.size());
+	span_sink sink(result,result.appendText(text.data(),text.size()));
+	if (fastLatin && utf8) return fenci_split(sf,text,!ignoreSign,latin,sink);
+	return fenci_parse(sf,text.data(),0,text.size(),sink);
+}
+
+bool CFenci::feedText(const char* data,const size_t len,CTokenIntern& result)
+{
+	const char* p = data;
+	size_t left = len;
+	while (left > 0)
+	{
+		size_t room = (pending.size() < STREAM_CHUNK) ? STREAM_CHUNK - pending.size() : 0;
+		size_t n = (left < room) ? left : room;
+		pending.append(p,n);
+		normalizePending(false);
+		p += n;
+		left -= n;
+
+		if (pending.size() >= STREAM_CHUNK && false == flushText(result,false)) return false;
+	}
+
+	return true;
+}
+
+bool CFenci::finishText(CTokenIntern& result)
+{
+	normalizePending(true);
+	bool ok = flushText(result,true);
+	pending.clear();
+	normDigits = false;
+	normEnd = 0;
+
+	return ok;
+}
+
+/* pending up to its last whole character, all of it if last */
+void CFenci::normalizePending(const bool last)
+{
+	if (!utf8 || normFlags == 0)
+	{
+		normEnd = pending.size();
+		return;
+	}
+
+	size_t len = pending.size() - normEnd;
+	if (!last) len = utf8_complete(pending.data() + normEnd,len);
+	if (len == 0) return;
+
+	size_t n = normalize_text(&pending[normEnd],len,normFlags,normDigits);
+	pending.erase(normEnd + n,len - n);
+	normEnd += n;
+}
+
+bool CFenci::flushText(CTokenIntern& result,const bool last)
+{
+	scws_t sf = getFork();
+	if (sf == NULL) return false;
+
+	size_t cut = pending.size();
+	if (!last)
+	{
+		cut -= STREAM_OVERLAP;
+
+		/* on a space if there is one, so fenci_split() sees whole chunks,
+		 * else at least not inside a utf-8 character */
+		size_t space = cut;
+		while (space > cut - STREAM_CHUNK / 2 && !is_space(pending[space])) --space;
+		if (is_space(pending[space])) cut = space;
+		else while (cut > 0 && ((unsigned char)pending[cut] & 0xC0) == 0x80) --cut;
+	}
+
+	cut_sink sink(result,cut);
+	bool ok = (fastLatin && utf8) ? fenci_split(sf,pending,!ignoreSign,latin,sink)
+		: fenci_parse(sf,pending.data(),0,pending.size(),sink);
+
+	/* go on with the first token cut, unless it is junk longer than half a chunk */
+	size_t resume = cut;
+	if (cut - sink.dropped <= STREAM_CHUNK / 2) resume = sink.dropped;
+	pending.erase(0,resume);
+	/* the cut is STREAM_OVERLAP before the end, far from normEnd */
+	normEnd -= resume;
+
+	return ok;
+}
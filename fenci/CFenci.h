@@ -9,20 +9,71 @@ using std::set;
 
 #include <scws/scws.h>
 
+#include "CTokenIntern.h"
+
 class CFenci
 {
 public:
 	CFenci();
+	/* fork of parent: shares its dict and rules, one per thread */
+	CFenci(const CFenci& parent);
 	~CFenci();
 	
-	bool setDict(const string dictFile);
+	/* inMemory loads the whole xdb, required when forks run in threads;
+	 * without it every lookup reads the file. Forks made after an in
+	 * memory load share it, also across fork() of the process. */
+	bool setDict(const string dictFile,const bool inMemory = false);
 	bool setRule(const string ruleFile);
 	bool setCharset(const string charset);
 	bool setIgnoreSign();
+	/* utf-8 text without CJK skips scws (see TextScan.h). Off by default:
+	 * the tokens differ from scws' in places, so turn it on only for a
+	 * store fed with it on, or retrain */
+	void setFastLatin(const bool on);
+	/* NORM_* of TextScan.h applied to utf-8 text before it is split,
+	 * none by default; a store only matches tokens normalized the way
+	 * it was fed, so changing this means a retrain */
+	void setNormalize(const int flags);
 
 	bool getFenciResult(const string strToParse,set<string>& result);
+	/* same into dense ids, tokens are spans of result's copy of the
+	 * text; result is added to, not cleared */
+	bool getFenciResult(const string& strToParse,CTokenIntern& result);
+	/* same for a text fed in pieces of any size, finishText() ends it; a
+	 * word cut by a piece boundary is parsed with the next piece. result
+	 * only gets copies of the distinct tokens, so memory is bounded by
+	 * the piece size, not the text. One text at a time. */
+	bool feedText(const char* data,const size_t len,CTokenIntern& result);
+	bool finishText(CTokenIntern& result);
 private:
 	scws_t s;
+	/* fork of s that does the parsing, made by the constructor and the
+	 * setters so parsing never forks: scws counts references to a shared
+	 * dict without a lock. One CFenci must not parse in two threads */
+	scws_t sf;
+	bool ignoreSign;
+	bool fastLatin;
+	bool utf8;
+	int normFlags;
+	/* fed text ended in a digit run */
+	bool normDigits;
+	/* pending[0,normEnd) is normalized, the rest is the start of a
+	 * character cut by the piece boundary */
+	size_t normEnd;
+	/* normalized copy of the text being parsed */
+	string normText;
+	/* words of the last latin run, kept to reuse the memory */
+	vector<token_span_t> latin;
+	/* fed text not parsed yet */
+	string pending;
+
+	scws_t getFork();
+	void reFork();
+	void normalizePending(const bool last);
+	bool flushText(CTokenIntern& result,const bool last);
+	const string& normalize(const string& text);
+
+	CFenci& operator=(const CFenci&);
 };
 
 #endif /*_CFENCI_H_*/
@@ -0,0 +1,227 @@
+#include "CTokenIntern.h"
+
+#include <string.h>
+
+const size_t MIN_SLOTS = 64;
+/* guess at the distinct tokens in textLen bytes, only used for sizing */
+const size_t BYTES_PER_TOKEN = 4;
+const uint32_t NO_TOKEN = (uint32_t)-1;
+
+CTokenIntern::CTokenIntern() : slots(MIN_SLOTS,0),pairsOn(false),last(NO_TOKEN),pairSlots(MIN_SLOTS,0)
+{
+}
+
+CTokenIntern::~CTokenIntern()
+{
+}
+
+/* FNV-1a */
+uint32_t CTokenIntern::hashBytes(const char* data,const size_t len)
+{
+	uint32_t h = 2166136261U;
+	for (size_t i = 0; i < len; ++i)
+	{
+		h ^= (unsigned char)data[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/* the id of the token or -1 with slot set to the free slot it goes into */
+uint32_t CTokenIntern::Find(const char* data,const size_t len,const uint32_t hash,size_t& slot) const
+{
+	size_t mask = slots.size() - 1;
+	for (slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		uint32_t id = slots[slot] - 1;
+		if (hashes[id] == hash && spans[id].len == len
+			&& memcmp(text.data() + spans[id].off,data,len) == 0)
+		{
+			return id;
+		}
+	}
+
+	return (uint32_t)-1;
+}
+
+void CTokenIntern::Rehash(const size_t minIds)
+{
+	size_t size = slots.size();
+	while (size < 2 * minIds) size *= 2;
+	if (size == slots.size()) return;
+
+	slots.assign(size,0);
+	size_t mask = size - 1;
+	for (uint32_t id = 0; id < spans.size(); ++id)
+	{
+		size_t slot = hashes[id] & mask;
+		while (slots[slot] != 0) slot = (slot + 1) & mask;
+		slots[slot] = id + 1;
+	}
+}
+
+void CTokenIntern::Reserve(const size_t textLen)
+{
+	text.reserve(text.size() + textLen);
+	Rehash(spans.size() + textLen / BYTES_PER_TOKEN);
+}
+
+size_t CTokenIntern::appendText(const char* data,const size_t len)
+{
+	size_t off = text.size();
+	text.append(data,len);
+
+	return off;
+}
+
+uint32_t CTokenIntern::addSpan(const size_t off,const size_t len)
+{
+	const char* data = text.data() + off;
+	uint32_t hash = hashBytes(data,len);
+
+	size_t slot = 0;
+	uint32_t id = Find(data,len,hash,slot);
+	if (id != (uint32_t)-1)
+	{
+		++counts[id];
+	}
+	else
+	{
+		id = spans.size();
+		token_span_t span = {(uint32_t)off,(uint32_t)len};
+		spans.push_back(span);
+		hashes.push_back(hash);
+		counts.push_back(1);
+		slots[slot] = id + 1;
+
+		if (2 * spans.size() > slots.size()) Rehash(spans.size());
+	}
+
+	if (pairsOn)
+	{
+		if (last != NO_TOKEN) addPair((uint64_t)last << 32 | id);
+		last = id;
+	}
+
+	return id;
+}
+
+uint32_t CTokenIntern::Add(const char* data,const size_t len)
+{
+	size_t off = appendText(data,len);
+	uint32_t id = addSpan(off,len);
+
+	/* a token seen before keeps its first span */
+	if (spans[id].off != off) text.resize(off);
+
+	return id;
+}
+
+uint32_t CTokenIntern::Add(const string& token)
+{
+	return Add(token.data(),token.size());
+}
+
+/* the buffer, the arrays and the table stay allocated for the next message */
+void CTokenIntern::Clear()
+{
+	text.clear();
+	spans.clear();
+	hashes.clear();
+	counts.clear();
+	slots.assign(slots.size(),0);
+
+	last = NO_TOKEN;
+	pairs.clear();
+	pairSlots.assign(pairSlots.size(),0);
+}
+
+void CTokenIntern::setPairs(const bool on)
+{
+	pairsOn = on;
+	last = NO_TOKEN;
+}
+
+void CTokenIntern::Break()
+{
+	last = NO_TOKEN;
+}
+
+const vector<uint64_t>& CTokenIntern::getPairs() const
+{
+	return pairs;
+}
+
+static inline size_t pair_slot(const uint64_t pair,const size_t mask)
+{
+	/* murmur3 finalizer, ids are small and dense */
+	uint64_t h = pair;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	return h & mask;
+}
+
+void CTokenIntern::addPair(const uint64_t pair)
+{
+	size_t mask = pairSlots.size() - 1;
+	size_t slot = pair_slot(pair,mask);
+	for (; pairSlots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		if (pairs[pairSlots[slot] - 1] == pair) return;
+	}
+
+	pairs.push_back(pair);
+	pairSlots[slot] = pairs.size();
+	if (2 * pairs.size() <= pairSlots.size()) return;
+
+	pairSlots.assign(2 * pairSlots.size(),0);
+	mask = pairSlots.size() - 1;
+	for (size_t i = 0; i < pairs.size(); ++i)
+	{
+		slot = pair_slot(pairs[i],mask);
+		while (pairSlots[slot] != 0) slot = (slot + 1) & mask;
+		pairSlots[slot] = i + 1;
+	}
+}
+
+size_t CTokenIntern::getSize() const
+{
+	return spans.size();
+}
+
+const string& CTokenIntern::getText() const
+{
+	return text;
+}
+
+const token_span_t& CTokenIntern::getSpan(const uint32_t id) const
+{
+	return spans[id];
+}
+
+const char* CTokenIntern::getData(const uint32_t id) const
+{
+	return text.data() + spans[id].off;
+}
+
+string CTokenIntern::getToken(const uint32_t id) const
+{
+	return string(getData(id),spans[id].len);
+}
+
+void CTokenIntern::getTokens(vector<string>& tokens) const
+{
+	tokens.resize(spans.size());
+	for (uint32_t id = 0; id < spans.size(); ++id)
+	{
+		tokens[id].assign(getData(id),spans[id].len);
+	}
+}
+
+uint32_t CTokenIntern::getCount(const uint32_t id) const
+{
+	return counts[id];
+}
@@ -0,0 +1,86 @@
+#ifndef _CTOKENINTERN_H_
+#define _CTOKENINTERN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/* a token as a view into CTokenIntern::getText() */
+struct token_span_t
+{
+	uint32_t off;
+	uint32_t len;
+};
+
+/*
+ * the distinct tokens of one message, each with a dense id 0..n-1 in
+ * order of first appearance. Lookup results and fws then live in flat
+ * arrays indexed by id instead of string keyed trees.
+ *
+ * The text of the message is copied into one buffer and every token is
+ * a span of it; dedup is an open addressing table of ids, so a token
+ * costs no allocation of its own. Clear() keeps all the memory, so reuse
+ * one object for every message.
+ */
+class CTokenIntern
+{
+public:
+	CTokenIntern();
+	~CTokenIntern();
+
+	/* room for about textLen more bytes of text and their tokens */
+	void Reserve(const size_t textLen);
+	/* append to the text buffer, returns the offset of data in it */
+	size_t appendText(const char* data,const size_t len);
+	/* id of the token getText()[off,off+len), a new one if it is not in yet */
+	uint32_t addSpan(const size_t off,const size_t len);
+	/* same for a token not in the text yet, it is copied there if new */
+	uint32_t Add(const char* data,const size_t len);
+	uint32_t Add(const string& token);
+	void Clear();
+
+	/* with pairs on, every two tokens added one after the other are
+	 * recorded as a pair of ids, each pair once; Break() separates texts
+	 * that are not next to each other, like subject and body */
+	void setPairs(const bool on);
+	void Break();
+	/* first id << 32 | second id, in order of first appearance */
+	const vector<uint64_t>& getPairs() const;
+
+	size_t getSize() const;
+	const string& getText() const;
+	const token_span_t& getSpan(const uint32_t id) const;
+	/* valid until the next appendText()/Add() */
+	const char* getData(const uint32_t id) const;
+	string getToken(const uint32_t id) const;
+	/* tokens[id], the strings already in tokens are reused */
+	void getTokens(vector<string>& tokens) const;
+	/* how often the token was added */
+	uint32_t getCount(const uint32_t id) const;
+
+private:
+	string text;
+	vector<token_span_t> spans;
+	vector<uint32_t> hashes;
+	vector<uint32_t> counts;
+	/* id + 1 per slot, 0 is free; size is a power of two, at most half full */
+	vector<uint32_t> slots;
+
+	bool pairsOn;
+	uint32_t last;
+	vector<uint64_t> pairs;
+	/* index + 1 into pairs, same scheme as slots */
+	vector<uint32_t> pairSlots;
+
+	static uint32_t hashBytes(const char* data,const size_t len);
+	uint32_t Find(const char* data,const size_t len,const uint32_t hash,size_t& slot) const;
+	void Rehash(const size_t minIds);
+	void addPair(const uint64_t pair);
+};
+
+#endif /*_CTOKENINTERN_H_*/
@@ -0,0 +1,220 @@
+#include "TextScan.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* lead byte of the 2 byte latin-1 signs, U+0080..U+00BF */
+const unsigned char LATIN1_SIGNS = 0xC2;
+
+static inline bool is_word(const unsigned char c)
+{
+	return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z')
+		|| (c >= 0x80 && c != LATIN1_SIGNS);
+}
+
+static inline bool is_sign(const unsigned char c)
+{
+	return c > ' ' && c < 0x7F && !is_word(c);
+}
+
+#ifdef __SSE2__
+/* bit i set if byte i is_word() */
+static inline int word_mask(const __m128i x)
+{
+	__m128i lower = _mm_or_si128(x,_mm_set1_epi8(0x20));
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower,_mm_set1_epi8('a' - 1)),
+		_mm_cmplt_epi8(lower,_mm_set1_epi8('z' + 1)));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x,_mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(x,_mm_set1_epi8('9' + 1)));
+	/* bytes >= 0x80 are negative as signed chars */
+	__m128i high = _mm_andnot_si128(_mm_cmpeq_epi8(x,_mm_set1_epi8((char)LATIN1_SIGNS)),
+		_mm_cmplt_epi8(x,_mm_setzero_si128()));
+
+	return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha,digit),high));
+}
+#endif
+
+size_t find_wide(const char* text,const size_t pos,const size_t len)
+{
+	size_t i = pos;
+#ifdef __SSE2__
+	/* 0xe0..0xff are -32..-1 as signed chars */
+	const __m128i low = _mm_set1_epi8((char)0xDF);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(text + i));
+		int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(x,low),_mm_cmplt_epi8(x,zero)));
+		if (mask != 0) return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < len; ++i)
+	{
+		if ((unsigned char)text[i] >= 0xE0) return i;
+	}
+
+	return len;
+}
+
+/* first offset in text[pos,end) whose is_word() is word, end if none */
+static size_t find_class(const char* text,const size_t pos,const size_t end,const bool word)
+{
+	size_t i = pos;
+#ifdef __SSE2__
+	for (; i + 16 <= end; i += 16)
+	{
+		int mask = word_mask(_mm_loadu_si128((const __m128i*)(text + i)));
+		if (!word) mask = ~mask & 0xFFFF;
+		if (mask != 0) return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < end; ++i)
+	{
+		if (is_word(text[i]) == word) return i;
+	}
+
+	return end;
+}
+
+void split_latin(const char* text,const size_t begin,const size_t end,const bool signs,
+		vector<token_span_t>& words)
+{
+	words.clear();
+
+	size_t i = begin;
+	while (i < end)
+	{
+		size_t start = find_class(text,i,end,true);
+		if (signs)
+		{
+			for (size_t k = i; k < start; ++k)
+			{
+				if (!is_sign(text[k])) continue;
+				token_span_t sign = {(uint32_t)k,1};
+				words.push_back(sign);
+			}
+		}
+		if (start >= end) break;
+
+		/* the second byte of a latin-1 sign is no word */
+		if (start > begin && (unsigned char)text[start - 1] == LATIN1_SIGNS
+			&& ((unsigned char)text[start] & 0xC0) == 0x80)
+		{
+			i = start + 1;
+			continue;
+		}
+
+		i = find_class(text,start,end,false);
+		token_span_t word = {(uint32_t)start,(uint32_t)(i - start)};
+		words.push_back(word);
+	}
+}
+
+/* one character of text[r] to text[w], both moved past it */
+static inline void normalize_char(char* text,const size_t len,size_t& r,size_t& w,
+		const int flags,bool& inDigits)
+{
+	unsigned char c = text[r];
+
+	/* U+FF01..U+FF5E are EF BC 81..EF BD 9E, ascii 0x21..0x7e */
+	if (c == 0xEF && (flags & NORM_WIDTH) && r + 2 < len)
+	{
+		unsigned char b1 = text[r + 1];
+		unsigned char b2 = text[r + 2];
+		if ((b1 == 0xBC && b2 >= 0x81 && b2 <= 0xBF) || (b1 == 0xBD && b2 >= 0x80 && b2 <= 0x9E))
+		{
+			c = 0x21 + ((b1 & 0x3F) << 6 | (b2 & 0x3F)) - 0xF01;
+			r += 2;
+		}
+	}
+	++r;
+
+	if (c >= '0' && c <= '9' && (flags & NORM_DIGITS))
+	{
+		if (!inDigits) text[w++] = '0';
+		inDigits = true;
+		return;
+	}
+	inDigits = false;
+
+	if (c >= 'A' && c <= 'Z' && (flags & NORM_CASE)) c |= 0x20;
+	text[w++] = c;
+}
+
+size_t normalize_text(char* text,const size_t len,const int flags,bool& inDigits)
+{
+	if (flags == 0) return len;
+
+	size_t r = 0;
+	size_t w = 0;
+	while (r < len)
+	{
+#ifdef __SSE2__
+		/* plain ascii without digits to collapse: fold 16 bytes at once */
+		if (r + 16 <= len)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)(text + r));
+			int skip = _mm_movemask_epi8(x);
+			if (flags & NORM_DIGITS)
+			{
+				skip |= _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(x,_mm_set1_epi8('0' - 1)),
+					_mm_cmplt_epi8(x,_mm_set1_epi8('9' + 1))));
+			}
+			if (skip == 0)
+			{
+				if (flags & NORM_CASE)
+				{
+					__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(x,_mm_set1_epi8('A' - 1)),
+						_mm_cmplt_epi8(x,_mm_set1_epi8('Z' + 1)));
+					x = _mm_add_epi8(x,_mm_and_si128(upper,_mm_set1_epi8(0x20)));
+				}
+				/* w <= r, x is loaded before the store can touch it */
+				_mm_storeu_si128((__m128i*)(text + w),x);
+				r += 16;
+				w += 16;
+				inDigits = false;
+				continue;
+			}
+		}
+#endif
+		size_t stop = r + 16;
+		while (r < stop && r < len) normalize_char(text,len,r,w,flags,inDigits);
+	}
+
+	return w;
+}
+
+bool parse_normalize(const char* names,int& flags)
+{
+	flags = 0;
+	while (*names != '\0')
+	{
+		size_t len = strcspn(names,",");
+		if (len == 4 && strncmp(names,"case",len) == 0) flags |= NORM_CASE;
+		else if (len == 5 && strncmp(names,"width",len) == 0) flags |= NORM_WIDTH;
+		else if (len == 6 && strncmp(names,"digits",len) == 0) flags |= NORM_DIGITS;
+		else return false;
+
+		names += len;
+		if (*names == ',') ++names;
+	}
+
+	return true;
+}
+
+size_t utf8_complete(const char* text,const size_t len)
+{
+	/* back over at most 3 continuation bytes to the lead byte */
+	size_t lead = len;
+	while (lead > 0 && len - lead < 3 && ((unsigned char)text[lead - 1] & 0xC0) == 0x80) --lead;
+	if (lead == 0) return len;
+
+	unsigned char c = text[lead - 1];
+	if (c < 0xC0) return len;
+	size_t need = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : 2;
+
+	return (len - (lead - 1) < need) ? lead - 1 : len;
+}
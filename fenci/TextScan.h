@@ -0,0 +1,52 @@
+#ifndef _TEXTSCAN_H_
+#define _TEXTSCAN_H_
+
+#include <stddef.h>
+
+#include <vector>
+using std::vector;
+
+#include "CTokenIntern.h"
+
+/*
+ * byte classes of utf-8 text for the tokenizer front end. "Wide" are the
+ * lead bytes of 3 and 4 byte sequences: CJK and everything else scws has
+ * a dictionary for. Text without them is split here, scws adds nothing to
+ * space delimited scripts.
+ *
+ * Uses SSE2 where the compiler has it, 16 bytes per step.
+ */
+
+/* offset of the first wide lead byte in text[pos,len), len if none */
+size_t find_wide(const char* text,const size_t pos,const size_t len);
+
+/* words of text[begin,end), which has no wide characters: runs of ascii
+ * letters and digits and 2 byte characters (latin, greek, cyrillic);
+ * latin-1 signs like nbsp separate words. With signs every ascii symbol
+ * is a token of its own as well, like scws does without ignore. words
+ * is cleared first, offsets are into text. */
+void split_latin(const char* text,const size_t begin,const size_t end,const bool signs,
+	vector<token_span_t>& words);
+
+/* what normalize_text() does */
+enum
+{
+	NORM_CASE = 1,		/* ascii to lower case */
+	NORM_WIDTH = 2,		/* full-width forms U+FF01..U+FF5E to ascii */
+	NORM_DIGITS = 4		/* every run of ascii digits to one '0' */
+};
+
+/* utf-8 text in place, it never grows; returns the new length. Obfuscated
+ * spelling ("ＶＩＡＧＲＡ", "ViAgRa") then makes one token instead of many.
+ * inDigits carries a digit run over text normalized in pieces, start it
+ * false; a piece must not end inside a full-width character. */
+size_t normalize_text(char* text,const size_t len,const int flags,bool& inDigits);
+
+/* NORM_* of a comma separated list of "case", "width" and "digits",
+ * false on any other name; "" is 0 */
+bool parse_normalize(const char* names,int& flags);
+
+/* length of text[0,len) without a utf-8 character cut off at its end */
+size_t utf8_complete(const char* text,const size_t len);
+
+#endif /*_TEXTSCAN_H_*/
@@ -0,0 +1,228 @@
+#include "CFenci.h"
+
+#include <string>
+using std::string;
+
+#include <fstream>
+using std::ifstream;
+
+#include <sstream>
+using std::stringstream;
+
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * bench -- tokenize a corpus with the scws dictionary held three ways
+ *
+ *	file:   every process opens the xdb, lookups read the file
+ *	mem:    every process loads the whole xdb into memory
+ *	shared: the parent loads it into memory once, the processes fork
+ *	        that engine and share its pages copy-on-write
+ *
+ * Like antispamd workers, each mode forks -p processes that load (or
+ * fork) the dictionary and tokenize the corpus -n times. Printed per mode
+ * are the average load time, tokenize throughput and private dirty
+ * memory of a process; the last one shows what sharing saves.
+ */
+
+enum
+{
+	MODE_FILE = 0,
+	MODE_MEM,
+	MODE_SHARED,
+	MODES
+};
+
+const char* MODE_NAMES[MODES] = {"file","mem","shared"};
+
+struct result_t
+{
+	double loadMs;
+	double parseSec;
+	long privateKb;
+	unsigned long tokens;
+};
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* pages still shared with the parent are not counted */
+static long private_kb()
+{
+	ifstream in("/proc/self/smaps_rollup");
+	string line;
+	long total = 0;
+	while (getline(in,line))
+	{
+		if (line.compare(0,14,"Private_Dirty:") == 0) total += atol(line.c_str() + 14);
+	}
+
+	return total;
+}
+
+static bool load_fenci(CFenci& fenci,const string& dict,const string& rule,const bool inMemory)
+{
+	if (false == fenci.setDict(dict,inMemory)) return false;
+	fenci.setRule(rule);
+	fenci.setCharset("utf-8");
+	fenci.setIgnoreSign();
+
+	return true;
+}
+
+static result_t run_child(CFenci* parent,const int mode,const string& dict,const string& rule,
+		const string& corpus,const int rounds)
+{
+	result_t r;
+	memset(&r,0,sizeof(r));
+
+	double start = now();
+	CFenci* fenci = (parent != NULL) ? new CFenci(*parent) : new CFenci();
+	if (parent == NULL && false == load_fenci(*fenci,dict,rule,mode == MODE_MEM))
+	{
+		cerr << "can't load dict " << dict << endl;
+		exit(-1);
+	}
+	r.loadMs = (now() - start) * 1000;
+
+	CTokenIntern tokens;
+	start = now();
+	for (int i = 0; i < rounds; ++i)
+	{
+		tokens.Clear();
+		fenci->getFenciResult(corpus,tokens);
+		r.tokens += tokens.getSize();
+	}
+	r.parseSec = now() - start;
+	r.privateKb = private_kb();
+
+	delete fenci;
+	return r;
+}
+
+static void usage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [-n rounds] [-p processes] <dict.xdb> <rules.ini> <corpus>" << endl;
+	exit(-1);
+}
+
+int main(int argc,char* argv[])
+{
+	int rounds = 10;
+	int processes = 4;
+
+	int opt;
+	while ((opt = getopt(argc,argv,"n:p:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': rounds = atoi(optarg); break;
+			case 'p': processes = atoi(optarg); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (argc - optind != 3 || rounds <= 0 || processes <= 0) usage(argv[0]);
+
+	const string dict = argv[optind];
+	const string rule = argv[optind + 1];
+
+	ifstream in(argv[optind + 2]);
+	if (!in)
+	{
+		cerr << "can't read " << argv[optind + 2] << endl;
+		exit(-1);
+	}
+	stringstream buf;
+	buf << in.rdbuf();
+	const string corpus = buf.str();
+
+	printf("%d processes, %d rounds of %lu bytes\n",processes,rounds,(unsigned long)corpus.size());
+	printf("%-8s %12s %12s %12s %12s\n","mode","load(ms)","MB/s","private(kB)","tokens");
+
+	for (int mode = 0; mode < MODES; ++mode)
+	{
+		CFenci* parent = NULL;
+		double parentMs = 0.0;
+		if (mode == MODE_SHARED)
+		{
+			double start = now();
+			parent = new CFenci();
+			if (false == load_fenci(*parent,dict,rule,true))
+			{
+				cerr << "can't load dict " << dict << endl;
+				exit(-1);
+			}
+			parentMs = (now() - start) * 1000;
+		}
+
+		int fds[2];
+		if (pipe(fds) < 0)
+		{
+			perror("pipe");
+			exit(-1);
+		}
+
+		for (int i = 0; i < processes; ++i)
+		{
+			pid_t pid = fork();
+			if (pid < 0)
+			{
+				perror("fork");
+				exit(-1);
+			}
+			if (pid == 0)
+			{
+				close(fds[0]);
+				result_t r = run_child(parent,mode,dict,rule,corpus,rounds);
+				_exit(write(fds[1],&r,sizeof(r)) == (ssize_t)sizeof(r) ? 0 : 1);
+			}
+		}
+		close(fds[1]);
+
+		result_t sum;
+		memset(&sum,0,sizeof(sum));
+		int got = 0;
+		result_t r;
+		while (read(fds[0],&r,sizeof(r)) == (ssize_t)sizeof(r))
+		{
+			sum.loadMs += r.loadMs;
+			sum.parseSec += r.parseSec;
+			sum.privateKb += r.privateKb;
+			sum.tokens += r.tokens;
+			++got;
+		}
+		close(fds[0]);
+		while (waitpid(-1,NULL,0) > 0);
+
+		if (got == 0)
+		{
+			cerr << MODE_NAMES[mode] << ": no results" << endl;
+			continue;
+		}
+
+		double mbs = (sum.parseSec > 0) ? corpus.size() * (double)rounds * got / sum.parseSec / 1000000.0 : 0.0;
+		printf("%-8s %12.1f %12.2f %12ld %12lu\n",MODE_NAMES[mode],sum.loadMs / got,
+			mbs,sum.privateKb / got,sum.tokens / got / rounds);
+		if (mode == MODE_SHARED) printf("%-8s %12.1f\n","(parent)",parentMs);
+
+		delete parent;
+	}
+
+	exit(0);
+}
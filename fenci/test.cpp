@@ -1,4 +1,5 @@
 #include "CFenci.h"
+#include "TextScan.h"
 
 #include <string>
 using std::string;
@@ -6,15 +7,248 @@ using std::string;
 #include <set>
 using std::set;
 
+#include <vector>
+using std::vector;
+
 #include <iostream>
 using std::cout;
+using std::cerr;
 using std::endl;
 
 #include <cstdlib>
+#include <cstdio>
+
+/*
+ * test -- checks of the tokenizer parts that need no dictionary, then
+ * the tokens of two sentences with the installed scws dictionary
+ */
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond),#cond,__FILE__,__LINE__)
+
+static void check(const bool ok,const char* what,const char* file,const int line)
+{
+	if (ok) return;
+
+	cerr << file << ":" << line << ": failed: " << what << endl;
+	++failures;
+}
+
+static void test_intern()
+{
+	CTokenIntern tokens;
+	CHECK(tokens.Add("viagra") == 0);
+	CHECK(tokens.Add("cheap") == 1);
+	CHECK(tokens.Add(string("viagra")) == 0);
+	CHECK(tokens.Add("viagr",5) == 2);
+	CHECK(tokens.getSize() == 3);
+	CHECK(tokens.getCount(0) == 2 && tokens.getCount(1) == 1);
+	CHECK(tokens.getToken(2) == "viagr");
+
+	/* a token seen before adds no text */
+	CHECK(tokens.getText() == "viagracheapviagr");
+
+	/* spans of text that is already in the buffer */
+	size_t off = tokens.appendText("cheap viagra",12);
+	CHECK(tokens.addSpan(off,5) == 1);
+	CHECK(tokens.addSpan(off + 6,6) == 0);
+	CHECK(tokens.addSpan(off + 1,4) == 3);
+	CHECK(tokens.getToken(3) == "heap");
+	CHECK(tokens.getSpan(3).off == off + 1 && tokens.getSpan(3).len == 4);
+	CHECK(tokens.getCount(0) == 3 && tokens.getCount(1) == 2);
+
+	/* enough tokens to grow the table a few times */
+	tokens.Reserve(1000);
+	for (int round = 0; round < 2; ++round)
+	{
+		for (int i = 0; i < 1000; ++i)
+		{
+			char token[16];
+			snprintf(token,sizeof(token),"t%d",i);
+			CHECK(tokens.Add(token) == (uint32_t)(4 + i));
+		}
+	}
+	CHECK(tokens.getSize() == 1004 && tokens.getCount(1003) == 2);
+
+	vector<string> all;
+	tokens.getTokens(all);
+	CHECK(all.size() == 1004 && all[0] == "viagra" && all[1003] == "t999");
+
+	tokens.Clear();
+	CHECK(tokens.getSize() == 0 && tokens.getText() == "");
+	CHECK(tokens.Add("t999") == 0 && tokens.getCount(0) == 1);
+}
+
+
+static void test_pairs()
+{
+	CTokenIntern tokens;
+	tokens.Add("before");
+	tokens.setPairs(true);
+
+	/* "a b a b c", then "c a" after a break */
+	tokens.Add("a");
+	tokens.Add("b");
+	tokens.Add("a");
+	tokens.Add("b");
+	tokens.Add("c");
+	tokens.Break();
+	tokens.Add("c");
+	tokens.Add("a");
+
+	const uint64_t PAIRS[] = {(uint64_t)1 << 32 | 2,(uint64_t)2 << 32 | 1,(uint64_t)2 << 32 | 3,(uint64_t)3 << 32 | 1};
+	CHECK(tokens.getPairs() == vector<uint64_t>(PAIRS,PAIRS + 4));
+
+	/* the pair table grows like the token table */
+	for (int i = 0; i < 1000; ++i)
+	{
+		char token[16];
+		snprintf(token,sizeof(token),"t%d",i);
+		tokens.Add(token);
+		tokens.Add("a");
+	}
+	CHECK(tokens.getPairs().size() == 4 + 2 * 1000);
+
+	tokens.Clear();
+	CHECK(tokens.getPairs().size() == 0);
+	tokens.Add("a");
+	tokens.Add("b");
+	CHECK(tokens.getPairs().size() == 1 && tokens.getPairs()[0] == 1);
+}
+
+/* split_latin() of the whole text, the words joined by '|' */
+static string latin_words(const string& text,const bool signs)
+{
+	vector<token_span_t> spans;
+	split_latin(text.data(),0,text.size(),signs,spans);
+
+	string words;
+	for (size_t i = 0; i < spans.size(); ++i)
+	{
+		if (i > 0) words += '|';
+		words.append(text,spans[i].off,spans[i].len);
+	}
+
+	return words;
+}
+
+static void test_latin()
+{
+	const string ascii(40,'a');
+	CHECK(find_wide("abc中",0,6) == 3);
+	CHECK(find_wide((ascii + "中").c_str(),0,43) == 40);
+	CHECK(find_wide((ascii + "中").c_str(),41,43) == 43);
+	CHECK(find_wide("caf\xc3\xa9",0,5) == 5);
+	CHECK(find_wide("\xf0\x9f\x98\x80",0,4) == 0);
+
+	CHECK(latin_words("Hello, world! 123abc",false) == "Hello|world|123abc");
+	CHECK(latin_words("Hi, you!",true) == "Hi|,|you|!");
+
+	/* 2 byte letters are part of words, latin-1 signs are not */
+	CHECK(latin_words("caf\xc3\xa9 ol\xc3\xa9",false) == "caf\xc3\xa9|ol\xc3\xa9");
+	CHECK(latin_words("\xd0\xbc\xd0\xb8\xd1\x80 x",false) == "\xd0\xbc\xd0\xb8\xd1\x80|x");
+	CHECK(latin_words("a\xc2\xa0" "b",false) == "a|b");
+	CHECK(latin_words("x\xc2\xab" "yz\xc2\xbb",false) == "x|yz");
+	CHECK(latin_words(ascii + " " + ascii,false) == ascii + "|" + ascii);
+	CHECK(latin_words("",true) == "");
 
+	/* offsets are into the text, words is cleared first */
+	vector<token_span_t> spans(3);
+	split_latin("xx abc yy",3,6,false,spans);
+	CHECK(spans.size() == 1 && spans[0].off == 3 && spans[0].len == 3);
+}
+
+static string normalized(string text,const int flags)
+{
+	bool inDigits = false;
+	text.resize(normalize_text(&text[0],text.size(),flags,inDigits));
+
+	return text;
+}
+
+/* fed step bytes at a time like CFenci::feedText(): each piece up to its
+ * last complete character, inDigits carried over */
+static string normalized_in_pieces(const string& text,const int flags,const size_t step)
+{
+	string out;
+	string pending;
+	bool inDigits = false;
+	for (size_t pos = 0; pos < text.size(); pos += step)
+	{
+		pending.append(text,pos,step);
+		size_t len = utf8_complete(pending.data(),pending.size());
+		string piece = pending.substr(0,len);
+		pending.erase(0,len);
+		piece.resize(normalize_text(&piece[0],piece.size(),flags,inDigits));
+		out += piece;
+	}
+	pending.resize(normalize_text(&pending[0],pending.size(),flags,inDigits));
+
+	return out + pending;
+}
+
+static void test_normalize()
+{
+	const string mixed = "ViAgRa CHEAP pills, Only Today and Tomorrow";
+	CHECK(normalized(mixed,0) == mixed);
+	CHECK(normalized(mixed,NORM_CASE) == "viagra cheap pills, only today and tomorrow");
+	CHECK(normalized("ＶＩＡＧＲＡ！",NORM_WIDTH) == "VIAGRA!");
+	CHECK(normalized("ＶＩＡＧＲＡ ｖｉａｇｒａ",NORM_WIDTH | NORM_CASE) == "viagra viagra");
+	CHECK(normalized("ＶＩＡＧＲＡ",NORM_CASE) == "ＶＩＡＧＲＡ");
+	CHECK(normalized("中文　ａ",NORM_WIDTH) == "中文　a");
+	CHECK(normalized("call 555-1234 now",NORM_DIGITS) == "call 0-0 now");
+	CHECK(normalized("１２3４ 00000000000000000000000000000000000000001",NORM_WIDTH | NORM_DIGITS) == "0 0");
+	CHECK(normalized("１２",NORM_DIGITS) == "１２");
+	/* a cut off full-width character is left alone */
+	CHECK(normalized("a\xef\xbc",NORM_WIDTH) == "a\xef\xbc");
+
+	/* a digit run over two pieces */
+	char first[] = "a12";
+	char second[] = "34b5";
+	bool inDigits = false;
+	CHECK(normalize_text(first,3,NORM_DIGITS,inDigits) == 2 && inDigits);
+	CHECK(normalize_text(second,4,NORM_DIGITS,inDigits) == 2);
+	CHECK(string(first,2) == "a0" && string(second,2) == "b0");
+	CHECK(inDigits);
+
+	const string text = "Ｖｉａ 12３4 ＧＲＡ 中文 99 " + mixed + " ＯＫ１";
+	for (int flags = 1; flags <= (NORM_CASE | NORM_WIDTH | NORM_DIGITS); ++flags)
+	{
+		const string whole = normalized(text,flags);
+		for (size_t step = 1; step <= 7; ++step)
+		{
+			CHECK(normalized_in_pieces(text,flags,step) == whole);
+		}
+	}
+
+	CHECK(utf8_complete("ab",2) == 2);
+	CHECK(utf8_complete("a\xef\xbc",3) == 1);
+	CHECK(utf8_complete("a\xef\xbc\xa9",4) == 4);
+	CHECK(utf8_complete("\xc3",1) == 0);
+	CHECK(utf8_complete("\xf0\x9f\x98",3) == 0);
+	CHECK(utf8_complete("\xf0\x9f\x98\x80",4) == 4);
+
+	int flags = -1;
+	CHECK(parse_normalize("",flags) && flags == 0);
+	CHECK(parse_normalize("case",flags) && flags == NORM_CASE);
+	CHECK(parse_normalize("width,digits,case",flags) && flags == (NORM_CASE | NORM_WIDTH | NORM_DIGITS));
+	CHECK(false == parse_normalize("case,lower",flags));
+	CHECK(false == parse_normalize("cases",flags));
+}
 
 int main(int argc,char* argv[])
 {
+	test_intern();
+	test_pairs();
+	test_latin();
+	test_normalize();
+	if (failures > 0)
+	{
+		cerr << failures << " checks failed" << endl;
+		exit(-1);
+	}
+
 	const string str = "我是一个中国人,我会C++语言,我也有很多T恤衣服";
 	const string charset = "utf-8";
 	set<string> result;
@@ -1,9 +1,13 @@
 #include "mime/MimeMessage.h"
 #include "mime/String.h"
 #include "fenci/CFenci.h"
+#include "fenci/TextScan.h"
 #include "comm/Common.h"
-#include "comm/CDataParse.h"
+#include "comm/TokenRecord.h"
 #include "CRedis.h"
+#include "CTokenDb.h"
+#include "comm/CTokenFile.h"
+#include "MailText.h"
 #include <map>
 #include <string>
 #include <cstdlib>
@@ -25,42 +29,121 @@ using namespace fast;
 
 FastString get_file_content(const string filename);
 
-int main(int argc,char* argv[])
+/* "token: bad good", a hashed store is asked for the hashes */
+static bool print_tokens(CTokenStore& myTokens,const set<string>& result)
 {
-	if (argc != 2)
+	vector<string> tokens(result.begin(),result.end());
+	vector<string> keys(tokens);
+	if (myTokens.isHashed())
 	{
-		cerr << "Usage: " << argv[0] << " <email>" << endl;
-		exit(-1);
+		for (size_t i = 0; i < keys.size(); ++i) keys[i] = CTokenKey::hashToken(keys[i]);
 	}
 
-	FastString email_data = get_file_content(argv[1]);
-        MimeMessage msg(email_data);
+	vector<b_word_t> words;
+	vector<bool> found;
+	if (false == myTokens.Lookup(keys,words,found))
+	{
+		cerr << myTokens.getError() << endl;
+		return false;
+	}
 
-        FastString charset="";
-	FastString plain = "";
-	FastString html = "";
-	FastString subject="";
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		if (myTokens.isHashed()) cout << "[" << CTokenKey::hashToHex(keys[i]) << "] ";
+		if (found[i])
+			cout << tokens[i] << ": " << words[i].bad << " " << words[i].good << endl;
+		else
+			cout << tokens[i] << ": " << endl;
+	}
 
+	return true;
+}
 
-	set<string> result;
-	CFenci myFenci;
-	myFenci.setDict("/usr/local/etc/dict_chs.utf8.xdb");
-	myFenci.setRule("/usr/local/etc/rules.utf8.ini");
-	myFenci.setCharset("utf-8");
-	myFenci.setIgnoreSign();
+/* hash -> token from the side table feed --names keeps */
+static bool print_names(CTokenDb& myTokens,char* hexes[],const int count)
+{
+	vector<string> hashed;
+	for (int i = 0; i < count; ++i)
+	{
+		string h;
+		if (false == CTokenKey::hexToHash(hexes[i],h))
+		{
+			cerr << hexes[i] << ": not a token hash" << endl;
+			return false;
+		}
+		hashed.push_back(h);
+	}
+
+	vector<string> tokens;
+	if (false == myTokens.getNames(hashed,tokens))
+	{
+		cerr << myTokens.getError() << endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < hashed.size() && i < tokens.size(); ++i)
+	{
+		cout << "[" << CTokenKey::hashToHex(hashed[i]) << "] " << tokens[i] << endl;
+	}
+
+	return true;
+}
 
-	/* parse subject */
-	msg.getSubject(subject,charset);
-	myFenci.getFenciResult(format_to_check(subject.c_str(),charset.c_str()),result);
+int main(int argc,char* argv[])
+{
+	string tokenPath = "";
+	bool resolve = false;
+	bool fastLatin = false;
+	int normFlags = 0;
+
+	int opt;
+	while ((opt = getopt(argc,argv,"f:iLZ:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f': tokenPath = optarg; break;
+			case 'i': resolve = true; break;
+			case 'L': fastLatin = true; break;
+			case 'Z': if (false == parse_normalize(optarg,normFlags)) optind = argc + 1; break;
+			default: optind = argc + 1;
+		}
+	}
+	if ((!resolve && optind != argc - 1) || (resolve && (optind >= argc || tokenPath != "")))
+	{
+		cerr << "Usage: " << argv[0] << " [-f token_file] [-L] [-Z case,width,digits] <email>" << endl;
+		cerr << "       " << argv[0] << " -i <token hash>..." << endl;
+		cerr << "  -L  split latin text without scws, as feed -L did" << endl;
+		cerr << "  -Z  normalize the text first, as feed -Z did" << endl;
+		exit(-1);
+	}
 
-	/* parse plain */
-        msg.getTextPlain(plain,charset);
-	myFenci.getFenciResult(format_to_check(subject.c_str(),charset.c_str()),result);	
+	set<string> result;
+	if (!resolve)
+	{
+		FastString email_data = get_file_content(argv[optind]);
+		CFenci myFenci;
+		myFenci.setDict("/usr/local/etc/dict_chs.utf8.xdb");
+		myFenci.setRule("/usr/local/etc/rules.utf8.ini");
+		myFenci.setCharset("utf-8");
+		myFenci.setIgnoreSign();
+		myFenci.setFastLatin(fastLatin);
+		myFenci.setNormalize(normFlags);
+
+		/* parse subject, plain and html */
+		get_mail_tokens(myFenci,email_data,result);
+	}
 
-	/* parse html */
-	msg.getTextHtml(html,charset);
-	string html_to_check = get_text_from_html(html.c_str());
-	myFenci.getFenciResult(format_to_check(html_to_check,charset.c_str()),result);
+	/* tokens of an exported file */
+	if (tokenPath != "")
+	{
+		CTokenFile tokenFile;
+		if (false == tokenFile.Open(tokenPath))
+		{
+			cerr << tokenFile.getError() << endl;
+			return -1;
+		}
+		exit(print_tokens(tokenFile,result) ? 0 : -1);
+	}
 
 	/* connect redis */
 	CRedis myRedis("127.0.0.1",6379);
@@ -72,16 +155,13 @@ int main(int argc,char* argv[])
 		return -1;
 	}
 
-	for (set<string>::iterator it = result.begin(); it != result.end(); ++it)
-	{
-		string buffer = myRedis.Get(*it);
-		cout << *it << ": " << buffer << endl;
-	}
+	CTokenDb myTokens(myRedis);
+	bool ok = resolve ? print_names(myTokens,argv + optind,argc - optind) : print_tokens(myTokens,result);
 
 	/* close redis */
 	myRedis.Close();
 
-	exit(0);
+	exit(ok ? 0 : -1);
 }
 
 FastString get_file_content(const string filename)
@@ -0,0 +1,409 @@
+#include "comm/TokenRecord.h"
+#include "comm/Common.h"
+#include "comm/CTokenKey.h"
+#include "comm/CBloomFilter.h"
+#include "CRedis.h"
+#include "CTokenDb.h"
+
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+using namespace std;
+
+/*
+ * migrate -- rewrite legacy "bad good" token records in the v1 binary
+ * format (see comm/TokenRecord.h). Values that are already v1 or are no
+ * token records at all are left alone, so it is safe to run it again.
+ *
+ * migrate -B <buckets> moves a store with one key per token into hash
+ * buckets (see comm/CTokenKey.h) and records the new layout at the end.
+ *
+ * migrate -H [-B <buckets>] rekeys a plain or bucketed store by token
+ * hashes, into the same or the given number of buckets. The bloom filter
+ * of the raw tokens is dropped with it, rebuild it with -F.
+ *
+ * migrate -F <bits per token> (re)builds the bloom filter of known tokens
+ * (see comm/CBloomFilter.h); feed keeps it up to date from then on.
+ *
+ * Stop the feeders while it runs, a concurrent update can be lost.
+ */
+
+/* each token moves in one MULTI/EXEC: a run that stops midway leaves
+ * every token either in its old key or in its bucket, never in both, so
+ * running it again moves the rest */
+static bool to_buckets(CRedis& myRedis,const CTokenKey& oldKeys,const CTokenKey& keys,
+		const vector<string>& tokens,const vector<string>& values,unsigned long& migrated)
+{
+	const vector<string> multi(1,"MULTI");
+	const vector<string> exec(1,"EXEC");
+	vector<string> args(4);
+	vector<string> del(2);
+	del[0] = "DEL";
+	size_t pending = 0;
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		b_word_t word = {0,0};
+		if (!oldKeys.isTokenKey(tokens[i]) || !decode_record(values[i],word)) continue;
+
+		if (!myRedis.Append(multi)) return false;
+		args[0] = "HINCRBY";
+		args[1] = keys.key(tokens[i]);
+		args[2] = keys.badField(tokens[i]);
+		args[3] = my_int2str(word.bad);
+		if (!myRedis.Append(args)) return false;
+		args[2] = keys.goodField(tokens[i]);
+		args[3] = my_int2str(word.good);
+		if (!myRedis.Append(args)) return false;
+		del[1] = tokens[i];
+		if (!myRedis.Append(del) || !myRedis.Append(exec)) return false;
+
+		pending += 5;
+		++migrated;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < pending; ++i)
+	{
+		if (!myRedis.GetReply()) ok = false;
+	}
+
+	return ok;
+}
+
+/* hashes already moved by migrate -H, so a rerun never takes one for a
+ * token; deleted when the layout is switched */
+#define MOVED_KEY "antispam migrate moved"
+
+/* like to_buckets(): each token moves in one MULTI/EXEC */
+static bool to_hashed(CRedis& myRedis,const CTokenKey& oldKeys,const CTokenKey& keys,
+		const vector<string>& tokens,const vector<b_word_t>& words,unsigned long& migrated)
+{
+	/* only a token of hash size can be a hash moved by an earlier run */
+	vector<string> args(3);
+	args[0] = "SISMEMBER";
+	args[1] = MOVED_KEY;
+	vector<size_t> checked;
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		if (tokens[i].size() != HASHED_TOKEN_SIZE) continue;
+		args[2] = tokens[i];
+		if (!myRedis.Append(args)) return false;
+		checked.push_back(i);
+	}
+	vector<bool> moved(tokens.size(),false);
+	for (size_t j = 0; j < checked.size(); ++j)
+	{
+		long long member = 0;
+		if (!myRedis.GetReply(member)) return false;
+		moved[checked[j]] = (member != 0);
+	}
+
+	const vector<string> multi(1,"MULTI");
+	const vector<string> exec(1,"EXEC");
+	size_t pending = 0;
+	for (size_t i = 0; i < tokens.size(); ++i)
+	{
+		if (moved[i]) continue;
+
+		const string hashed = CTokenKey::hashToken(tokens[i]);
+		vector<vector<string> > commands;
+		commands.push_back(multi);
+		if (keys.isBucketed())
+		{
+			vector<string> incr(4);
+			incr[0] = "HINCRBY";
+			incr[1] = keys.key(hashed);
+			incr[2] = keys.badField(hashed);
+			incr[3] = my_int2str(words[i].bad);
+			commands.push_back(incr);
+			incr[2] = keys.goodField(hashed);
+			incr[3] = my_int2str(words[i].good);
+			commands.push_back(incr);
+		}
+		else
+		{
+			/* two tokens of one hash are one token in a hashed store anyway */
+			vector<string> put(3);
+			put[0] = "SET";
+			put[1] = hashed;
+			put[2] = encode_record(words[i]);
+			commands.push_back(put);
+		}
+
+		vector<string> del;
+		if (oldKeys.isBucketed())
+		{
+			del.push_back("HDEL");
+			del.push_back(oldKeys.key(tokens[i]));
+			del.push_back(oldKeys.badField(tokens[i]));
+			del.push_back(oldKeys.goodField(tokens[i]));
+		}
+		else
+		{
+			del.push_back("DEL");
+			del.push_back(tokens[i]);
+		}
+		commands.push_back(del);
+
+		vector<string> add(3);
+		add[0] = "SADD";
+		add[1] = MOVED_KEY;
+		add[2] = hashed;
+		commands.push_back(add);
+		commands.push_back(exec);
+
+		for (size_t j = 0; j < commands.size(); ++j)
+		{
+			if (!myRedis.Append(commands[j])) return false;
+		}
+		pending += commands.size();
+		++migrated;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < pending; ++i)
+	{
+		if (!myRedis.GetReply()) ok = false;
+	}
+
+	return ok;
+}
+
+/* the new layout, without the bloom filter of raw tokens and the moved set */
+static bool switch_to_hashed(CRedis& myRedis,const CTokenKey& keys)
+{
+	vector<vector<string> > commands(4);
+	commands[0].push_back("MULTI");
+	commands[1].push_back("SET");
+	commands[1].push_back(LAYOUT_KEY);
+	commands[1].push_back(keys.getLayout());
+	commands[2].push_back("DEL");
+	commands[2].push_back(BLOOM_KEY);
+	commands[2].push_back(BLOOM_PARAMS_KEY);
+	commands[2].push_back(MOVED_KEY);
+	commands[3].push_back("EXEC");
+
+	bool ok = true;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (false == myRedis.Append(commands[i])) ok = false;
+	}
+	for (size_t i = 0; ok && i < commands.size(); ++i)
+	{
+		if (false == myRedis.GetReply()) ok = false;
+	}
+
+	return ok;
+}
+
+/* two passes over the store: count to size the filter, then fill it */
+static bool build_bloom(CRedis& myRedis,CTokenDb& myTokens,const unsigned int bitsPerToken,
+		unsigned long& scanned)
+{
+	CBloomFilter bloom;
+	vector<string> tokens;
+	vector<b_word_t> words;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 1) bloom.Init(scanned,bitsPerToken);
+
+		string cursor = "0";
+		do
+		{
+			if (false == myTokens.Scan(cursor,tokens,words))
+			{
+				cerr << myTokens.getError() << endl;
+				return false;
+			}
+			if (pass == 0) scanned += tokens.size();
+			else for (size_t i = 0; i < tokens.size(); ++i) bloom.Add(tokens[i]);
+		} while (cursor != "0");
+	}
+
+	/* bits and parameters change together */
+	vector<vector<string> > commands(4);
+	commands[0].push_back("MULTI");
+	commands[1].push_back("SET");
+	commands[1].push_back(BLOOM_KEY);
+	commands[1].push_back(bloom.getBitmap());
+	commands[2].push_back("SET");
+	commands[2].push_back(BLOOM_PARAMS_KEY);
+	commands[2].push_back(bloom.getParams());
+	commands[3].push_back("EXEC");
+
+	bool ok = true;
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		if (false == myRedis.Append(commands[i])) ok = false;
+	}
+	for (size_t i = 0; ok && i < commands.size(); ++i)
+	{
+		if (false == myRedis.GetReply()) ok = false;
+	}
+	if (!ok) cerr << myRedis.getError() << endl;
+
+	return ok;
+}
+
+int main(int argc,char* argv[])
+{
+	string redisIp = "127.0.0.1";
+	int redisPort = 6379;
+	string redisSocket = "";
+	int buckets = -1;
+	int bloomBits = 0;
+	bool hashed = false;
+
+	int opt;
+	while ((opt = getopt(argc,argv,"r:p:u:B:F:H")) != -1)
+	{
+		switch (opt)
+		{
+			case 'r': redisIp = optarg; break;
+			case 'p': redisPort = atoi(optarg); break;
+			case 'u': redisSocket = optarg; break;
+			case 'B': buckets = atoi(optarg); break;
+			case 'F': bloomBits = atoi(optarg); break;
+			case 'H': hashed = true; break;
+			default:
+				cerr << "Usage: " << argv[0] << " [-r redis_ip] [-p redis_port] [-u redis_socket] [-B buckets | -H [-B buckets] | -F bits_per_token]" << endl;
+				exit(-1);
+		}
+	}
+
+	CRedis myRedis(redisIp,redisPort);
+	const int CONNECT_TIMEOUT = 1;
+	myRedis.setTimeout(CONNECT_TIMEOUT);
+	if (redisSocket != "") myRedis.setUnixSocket(redisSocket);
+	if (false == myRedis.Connect())
+	{
+		cerr << myRedis.getError() << endl;
+		return -1;
+	}
+
+	CTokenDb myTokens(myRedis);
+	if (false == myTokens.loadLayout())
+	{
+		cerr << myTokens.getError() << endl;
+		return -1;
+	}
+	if ((buckets > 0 && !hashed && myTokens.getKeys().isBucketed()) || (hashed && myTokens.isHashed()))
+	{
+		cerr << "store already has layout " << myTokens.getKeys().getLayout() << endl;
+		return -1;
+	}
+
+	unsigned long scanned = 0;
+	if (bloomBits > 0)
+	{
+		if (false == build_bloom(myRedis,myTokens,bloomBits,scanned)) return -1;
+
+		myRedis.Close();
+		cout << "bloom filter of " << scanned << " tokens" << endl;
+		exit(0);
+	}
+
+	if (hashed)
+	{
+		CTokenKey oldKeys = myTokens.getKeys();
+		CTokenKey newKeys;
+		newKeys.setBuckets(buckets > 0 ? buckets : oldKeys.getBuckets());
+		newKeys.setHashed(true);
+
+		unsigned long migrated = 0;
+		string cursor = "0";
+		vector<string> tokens;
+		vector<b_word_t> words;
+		do
+		{
+			if (false == myTokens.Scan(cursor,tokens,words))
+			{
+				cerr << myTokens.getError() << endl;
+				return -1;
+			}
+
+			scanned += tokens.size();
+			if (false == to_hashed(myRedis,oldKeys,newKeys,tokens,words,migrated))
+			{
+				cerr << myRedis.getError() << endl;
+				return -1;
+			}
+		} while (cursor != "0");
+
+		if (false == switch_to_hashed(myRedis,newKeys))
+		{
+			cerr << myRedis.getError() << endl;
+			return -1;
+		}
+
+		myRedis.Close();
+		cout << "scanned " << scanned << " tokens, migrated " << migrated << ", layout " << newKeys.getLayout() << endl;
+		exit(0);
+	}
+
+	/* a hashed store stays hashed */
+	CTokenKey newKeys;
+	if (buckets > 0) newKeys.setBuckets(buckets);
+	newKeys.setHashed(myTokens.getKeys().isHashed());
+
+	unsigned long migrated = 0;
+	string cursor = "0";
+	vector<string> keys;
+	vector<string> values;
+	do
+	{
+		if (false == myRedis.Scan(cursor,keys) || false == myRedis.MGet(keys,values))
+		{
+			cerr << myRedis.getError() << endl;
+			return -1;
+		}
+
+		scanned += keys.size();
+		if (newKeys.isBucketed())
+		{
+			if (false == to_buckets(myRedis,myTokens.getKeys(),newKeys,keys,values,migrated))
+			{
+				cerr << myRedis.getError() << endl;
+				return -1;
+			}
+			continue;
+		}
+
+		vector<string> legacyKeys;
+		vector<string> newValues;
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			/* bloom bits, layout and names may look like a legacy record */
+			if (!myTokens.getKeys().isTokenKey(keys[i])) continue;
+
+			b_word_t word = {0,0};
+			if (is_legacy_record(values[i]) && decode_record(values[i],word))
+			{
+				legacyKeys.push_back(keys[i]);
+				newValues.push_back(encode_record(word));
+			}
+		}
+
+		if (false == myRedis.MSet(legacyKeys,newValues))
+		{
+			cerr << myRedis.getError() << endl;
+			return -1;
+		}
+		migrated += legacyKeys.size();
+	} while (cursor != "0");
+
+	if (newKeys.isBucketed() && false == myRedis.Set(LAYOUT_KEY,newKeys.getLayout()))
+	{
+		cerr << myRedis.getError() << endl;
+		return -1;
+	}
+
+	myRedis.Close();
+
+	cout << "scanned " << scanned << " keys, migrated " << migrated << endl;
+	exit(0);
+}
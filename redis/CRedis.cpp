@@ -3,6 +3,9 @@
 #define REDIS_FREE(x) { if (x != NULL) {redisFree(x); x = NULL;} }
 #define REPLY_FREE(x) { if (x != NULL) {freeReplyObject(x); x = NULL;} }
 
+/* keys per MGET command */
+#define DEFAULT_BATCH_SIZE 256
+
 CRedis::CRedis(const string hostname_,const int port_) : hostname(hostname_),port(port_)
 {
 	c = NULL;
@@ -10,6 +13,8 @@ CRedis::CRedis(const string hostname_,const int port_) : hostname(hostname_),por
 	errorMsg = "";
 	timeout.tv_sec = 0;
 	timeout.tv_usec = 0;
+	pool = NULL;
+	batchSize = DEFAULT_BATCH_SIZE;
 }
 
 CRedis::CRedis()
@@ -19,12 +24,13 @@ CRedis::CRedis()
 	errorMsg = "";
 	timeout.tv_sec = 0;
 	timeout.tv_usec = 0;
+	pool = NULL;
+	batchSize = DEFAULT_BATCH_SIZE;
 }
 
 CRedis::~CRedis()
 {
-	REDIS_FREE(c);
-	REPLY_FREE(reply);
+	Close();
 }
 
 void CRedis::setIp(const string ip)
@@ -37,6 +43,22 @@ void CRedis::setPort(const int port_)
 	port = port_;
 }
 
+void CRedis::setUnixSocket(const string path)
+{
+	unixPath = path;
+}
+
+/* Connect()/Close() borrow from and return to the pool */
+void CRedis::setPool(CRedisPool* pool_)
+{
+	pool = pool_;
+}
+
+void CRedis::setBatchSize(const unsigned int size)
+{
+	batchSize = size > 0 ? size : DEFAULT_BATCH_SIZE;
+}
+
 void CRedis::setTimeout(const int sec,const int microsec)
 {
 	timeout.tv_sec = sec;
@@ -45,7 +67,19 @@ void CRedis::setTimeout(const int sec,const int microsec)
 
 bool CRedis::Connect()
 {
-	c = redisConnectWithTimeout(hostname.c_str(), port, timeout);
+	if (pool != NULL)
+	{
+		c = pool->Get();
+		if (c == NULL)
+		{
+			errorMsg = pool->getError();
+			return false;
+		}
+		return true;
+	}
+
+	if (unixPath != "") c = redisConnectUnixWithTimeout(unixPath.c_str(), timeout);
+	else c = redisConnectWithTimeout(hostname.c_str(), port, timeout);
 	
 	if (c == NULL || c->err) 
 	{
@@ -68,8 +102,18 @@ bool CRedis::Connect()
 
 void CRedis::Close()
 {
-	REDIS_FREE(c);
 	REPLY_FREE(reply);
+	if (pool != NULL)
+	{
+		pool->Put(c);
+		c = NULL;
+	}
+	REDIS_FREE(c);
+}
+
+bool CRedis::isConnected()
+{
+	return (c != NULL && c->err == 0);
 }
 
 string CRedis::getError()
@@ -79,8 +123,8 @@ string CRedis::getError()
 
 bool CRedis::Set(const string key,const string value)
 {
-	reply = (redisReply*)redisCommand(c,"SET %s %s",key.c_str(),value.c_str());
-	errorMsg = c->errstr ? string(c->errstr) : string("");
+	reply = (redisReply*)redisCommand(c,"SET %b %b",key.data(),key.size(),value.data(),value.size());
+	errorMsg = string(c->errstr);
 	REPLY_FREE(reply);
 	return c->err ? false : true;
 }
@@ -88,8 +132,15 @@ bool CRedis::Set(const string key,const string value)
 string CRedis::Get(const string key)
 {
 	string ret("");
-    	reply = (redisReply*)redisCommand(c,"GET %s",key.c_str());
-	ret = reply->str ? reply->str : "";
+	if (c == NULL) return ret;
+
+    	reply = (redisReply*)redisCommand(c,"GET %b",key.data(),key.size());
+	if (reply == NULL)
+	{
+		errorMsg = string(c->errstr);
+		return ret;
+	}
+	if (reply->type == REDIS_REPLY_STRING) ret = string(reply->str,reply->len);
 	REPLY_FREE(reply);
 	return ret;
 }
@@ -97,7 +148,266 @@ string CRedis::Get(const string key)
 bool CRedis::Delete(const string key)
 {
 	reply = (redisReply*)redisCommand(c,"DEL %s",key.c_str());
-	errorMsg = c->errstr ? string(c->errstr) : string("");
+	errorMsg = string(c->errstr);
 	REPLY_FREE(reply);
 	return c->err ? false : true;
 }
+
+bool CRedis::MGet(const vector<string>& keys,vector<string>& values)
+{
+	values.assign(keys.size(),string(""));
+	if (keys.empty()) return true;
+	if (c == NULL)
+	{
+		errorMsg = "not connected";
+		return false;
+	}
+
+	/* queue one MGET per batch, then read all replies: one round trip */
+	vector<const char*> argv;
+	vector<size_t> argvlen;
+	for (size_t begin = 0; begin < keys.size(); begin += batchSize)
+	{
+		size_t end = begin + batchSize < keys.size() ? begin + batchSize : keys.size();
+
+		argv.clear();
+		argvlen.clear();
+		argv.push_back("MGET");
+		argvlen.push_back(4);
+		for (size_t i = begin; i < end; ++i)
+		{
+			argv.push_back(keys[i].data());
+			argvlen.push_back(keys[i].size());
+		}
+
+		if (redisAppendCommandArgv(c,argv.size(),&argv[0],&argvlen[0]) != REDIS_OK)
+		{
+			errorMsg = string(c->errstr);
+			return false;
+		}
+	}
+
+	bool ok = true;
+	for (size_t begin = 0; begin < keys.size(); begin += batchSize)
+	{
+		void* r = NULL;
+		if (redisGetReply(c,&r) != REDIS_OK)
+		{
+			errorMsg = string(c->errstr);
+			return false;
+		}
+
+		reply = (redisReply*)r;
+		if (reply->type == REDIS_REPLY_ARRAY)
+		{
+			for (size_t i = 0; i < reply->elements && begin + i < keys.size(); ++i)
+			{
+				redisReply* e = reply->element[i];
+				if (e->type == REDIS_REPLY_STRING) values[begin + i] = string(e->str,e->len);
+			}
+		}
+		else
+		{
+			errorMsg = reply->str ? string(reply->str,reply->len) : string("unexpected MGET reply");
+			ok = false;
+		}
+		REPLY_FREE(reply);
+	}
+
+	return ok;
+}
+
+bool CRedis::MSet(const vector<string>& keys,const vector<string>& values)
+{
+	if (keys.empty()) return true;
+	if (c == NULL)
+	{
+		errorMsg = "not connected";
+		return false;
+	}
+
+	vector<const char*> argv;
+	vector<size_t> argvlen;
+	size_t batches = 0;
+	for (size_t begin = 0; begin < keys.size(); begin += batchSize)
+	{
+		size_t end = begin + batchSize < keys.size() ? begin + batchSize : keys.size();
+
+		argv.clear();
+		argvlen.clear();
+		argv.push_back("MSET");
+		argvlen.push_back(4);
+		for (size_t i = begin; i < end; ++i)
+		{
+			argv.push_back(keys[i].data());
+			argvlen.push_back(keys[i].size());
+			argv.push_back(values[i].data());
+			argvlen.push_back(values[i].size());
+		}
+
+		if (redisAppendCommandArgv(c,argv.size(),&argv[0],&argvlen[0]) != REDIS_OK)
+		{
+			errorMsg = string(c->errstr);
+			return false;
+		}
+		++batches;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < batches; ++i)
+	{
+		void* r = NULL;
+		if (redisGetReply(c,&r) != REDIS_OK)
+		{
+			errorMsg = string(c->errstr);
+			return false;
+		}
+
+		reply = (redisReply*)r;
+		if (reply->type == REDIS_REPLY_ERROR)
+		{
+			errorMsg = string(reply->str,reply->len);
+			ok = false;
+		}
+		REPLY_FREE(reply);
+	}
+
+	return ok;
+}
+
+bool CRedis::Scan(string& cursor,vector<string>& keys,const unsigned int count)
+{
+	keys.clear();
+	if (c == NULL)
+	{
+		errorMsg = "not connected";
+		return false;
+	}
+
+	reply = (redisReply*)redisCommand(c,"SCAN %s COUNT %u",cursor.c_str(),count);
+	if (reply == NULL)
+	{
+		errorMsg = string(c->errstr);
+		return false;
+	}
+
+	bool ok = false;
+	if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2)
+	{
+		cursor = string(reply->element[0]->str,reply->element[0]->len);
+
+		redisReply* list = reply->element[1];
+		for (size_t i = 0; i < list->elements; ++i)
+		{
+			keys.push_back(string(list->element[i]->str,list->element[i]->len));
+		}
+		ok = true;
+	}
+	else
+	{
+		errorMsg = reply->str ? string(reply->str,reply->len) : string("unexpected SCAN reply");
+	}
+	REPLY_FREE(reply);
+
+	return ok;
+}
+
+bool CRedis::Append(const vector<string>& args)
+{
+	if (c == NULL)
+	{
+		errorMsg = "not connected";
+		return false;
+	}
+
+	vector<const char*> argv(args.size());
+	vector<size_t> argvlen(args.size());
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		argv[i] = args[i].data();
+		argvlen[i] = args[i].size();
+	}
+
+	if (redisAppendCommandArgv(c,argv.size(),&argv[0],&argvlen[0]) != REDIS_OK)
+	{
+		errorMsg = string(c->errstr);
+		return false;
+	}
+
+	return true;
+}
+
+/* read the next pipelined reply into this->reply, false on error replies */
+bool CRedis::nextReply()
+{
+	REPLY_FREE(reply);
+	if (c == NULL)
+	{
+		errorMsg = "not connected";
+		return false;
+	}
+
+	void* r = NULL;
+	if (redisGetReply(c,&r) != REDIS_OK)
+	{
+		errorMsg = string(c->errstr);
+		return false;
+	}
+
+	reply = (redisReply*)r;
+	if (reply->type == REDIS_REPLY_ERROR)
+	{
+		errorMsg = string(reply->str,reply->len);
+		REPLY_FREE(reply);
+		return false;
+	}
+
+	return true;
+}
+
+bool CRedis::GetReply()
+{
+	bool ok = nextReply();
+	REPLY_FREE(reply);
+	return ok;
+}
+
+bool CRedis::GetReply(long long& value)
+{
+	value = 0;
+	if (!nextReply()) return false;
+
+	if (reply->type == REDIS_REPLY_INTEGER) value = reply->integer;
+	REPLY_FREE(reply);
+	return true;
+}
+
+bool CRedis::GetReply(string& value)
+{
+	value = "";
+	if (!nextReply()) return false;
+
+	if (reply->type == REDIS_REPLY_STRING || reply->type == REDIS_REPLY_STATUS)
+		value = string(reply->str,reply->len);
+	REPLY_FREE(reply);
+	return true;
+}
+
+/* array reply, nil elements become "" */
+bool CRedis::GetReply(vector<string>& values)
+{
+	values.clear();
+	if (!nextReply()) return false;
+
+	if (reply->type == REDIS_REPLY_ARRAY)
+	{
+		values.resize(reply->elements);
+		for (size_t i = 0; i < reply->elements; ++i)
+		{
+			redisReply* e = reply->element[i];
+			if (e->type == REDIS_REPLY_STRING) values[i] = string(e->str,e->len);
+		}
+	}
+	REPLY_FREE(reply);
+	return true;
+}
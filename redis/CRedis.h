@@ -3,12 +3,17 @@
 
 #include <hiredis/hiredis.h>
 
+#include "CRedisPool.h"
+
 #include <cstdio>
 #include <cstdlib>
 
 #include <string>
 using std::string;
 
+#include <vector>
+using std::vector;
+
 class CRedis
 {
 public:
@@ -18,21 +23,44 @@ public:
 
 	void setIp(const string ip);
 	void setPort(const int port);
+	void setUnixSocket(const string path);
+	void setPool(CRedisPool* pool);
 	void setTimeout(const int sec,const int microsec = 0);
+	void setBatchSize(const unsigned int size);
 	bool Connect();
 	void Close();
+	bool isConnected();
 	string getError();	
 
 	string Get(const string key);
 	bool Set(const string key,const string value);
 	bool Delete(const string key);
 
+	/* values[i] is the value of keys[i], "" if not exist */
+	bool MGet(const vector<string>& keys,vector<string>& values);
+	bool MSet(const vector<string>& keys,const vector<string>& values);
+
+	/* pipelining: queue commands, then read one reply per command in order */
+	bool Append(const vector<string>& argv);
+	bool GetReply();
+	bool GetReply(long long& value);
+	bool GetReply(string& value);
+	bool GetReply(vector<string>& values);
+
+	/* one SCAN step, start with cursor "0", done when it is "0" again */
+	bool Scan(string& cursor,vector<string>& keys,const unsigned int count = 1000);
+
 private:
+	bool nextReply();
+
     	redisContext *c;
     	redisReply *reply;
 	string errorMsg;
 	struct timeval timeout;
 	string hostname;
 	int port;
+	string unixPath;
+	CRedisPool* pool;
+	unsigned int batchSize;
 };
 #endif /*CREDIS_H*/
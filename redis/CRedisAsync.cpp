@@ -0,0 +1,244 @@
+#include "CRedisAsync.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/time.h>
+
+CRedisAsync::CRedisAsync(const string hostname_,const int port_) : hostname(hostname_),port(port_)
+{
+	ac = NULL;
+	reading = false;
+	writing = false;
+	pending = 0;
+	timeout = 0;
+	connectStart = 0;
+}
+
+CRedisAsync::CRedisAsync()
+{
+	ac = NULL;
+	reading = false;
+	writing = false;
+	pending = 0;
+	timeout = 0;
+	connectStart = 0;
+	port = 6379;
+}
+
+CRedisAsync::~CRedisAsync()
+{
+	Close();
+}
+
+void CRedisAsync::setIp(const string ip)
+{
+	hostname = ip;
+}
+
+void CRedisAsync::setPort(const int port_)
+{
+	port = port_;
+}
+
+void CRedisAsync::setUnixSocket(const string path)
+{
+	unixPath = path;
+}
+
+void CRedisAsync::setTimeout(const int sec,const int microsec)
+{
+	timeout = sec * 1000L + microsec / 1000;
+}
+
+static long now_ms()
+{
+	struct timeval tv;
+	gettimeofday(&tv,NULL);
+	return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+/* event hooks hiredis calls to tell us what to poll for */
+void CRedisAsync::addRead(void* privdata)
+{
+	((CRedisAsync*)privdata)->reading = true;
+}
+
+void CRedisAsync::delRead(void* privdata)
+{
+	((CRedisAsync*)privdata)->reading = false;
+}
+
+void CRedisAsync::addWrite(void* privdata)
+{
+	((CRedisAsync*)privdata)->writing = true;
+}
+
+void CRedisAsync::delWrite(void* privdata)
+{
+	((CRedisAsync*)privdata)->writing = false;
+}
+
+/* hiredis frees the context itself on errors, forget it here */
+void CRedisAsync::cleanup(void* privdata)
+{
+	CRedisAsync* self = (CRedisAsync*)privdata;
+	self->ac = NULL;
+	self->reading = false;
+	self->writing = false;
+}
+
+bool CRedisAsync::Connect()
+{
+	if (ac != NULL) return true;
+
+	if (unixPath != "") ac = redisAsyncConnectUnix(unixPath.c_str());
+	else ac = redisAsyncConnect(hostname.c_str(),port);
+
+	if (ac == NULL || ac->err)
+	{
+		errorMsg = ac ? string(ac->errstr) : string("Connection error: can't allocate redis context");
+		if (ac != NULL) redisAsyncFree(ac);
+		ac = NULL;
+		return false;
+	}
+
+	ac->data = this;
+	ac->ev.data = this;
+	ac->ev.addRead = addRead;
+	ac->ev.delRead = delRead;
+	ac->ev.addWrite = addWrite;
+	ac->ev.delWrite = delWrite;
+	ac->ev.cleanup = cleanup;
+
+	/* the non blocking connect completes on the first writable event */
+	writing = true;
+	connectStart = now_ms();
+	return true;
+}
+
+void CRedisAsync::Close()
+{
+	/* runs the pending callbacks with a NULL reply */
+	if (ac != NULL) redisAsyncFree(ac);
+	ac = NULL;
+	reading = false;
+	writing = false;
+	sentAt.clear();
+}
+
+bool CRedisAsync::isConnected()
+{
+	return ac != NULL && ac->err == 0;
+}
+
+string CRedisAsync::getError()
+{
+	return errorMsg;
+}
+
+size_t CRedisAsync::getPending()
+{
+	return pending;
+}
+
+void CRedisAsync::onReply(redisAsyncContext* ac,void* r,void* privdata)
+{
+	request_t* request = (request_t*)privdata;
+	CRedisAsync* self = request->self;
+
+	--self->pending;
+	if (!self->sentAt.empty()) self->sentAt.pop_front();
+	if (r == NULL && ac->err) self->errorMsg = string(ac->errstr);
+	request->callback((redisReply*)r,request->privdata);
+
+	delete request;
+}
+
+bool CRedisAsync::Command(const vector<string>& args,callback_t callback,void* privdata)
+{
+	if (ac == NULL && !Connect()) return false;
+
+	vector<const char*> argv(args.size());
+	vector<size_t> argvlen(args.size());
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		argv[i] = args[i].data();
+		argvlen[i] = args[i].size();
+	}
+
+	request_t* request = new request_t;
+	request->self = this;
+	request->callback = callback;
+	request->privdata = privdata;
+
+	if (redisAsyncCommandArgv(ac,onReply,request,argv.size(),&argv[0],&argvlen[0]) != REDIS_OK)
+	{
+		errorMsg = ac->errstr ? string(ac->errstr) : string("can't queue command");
+		delete request;
+		return false;
+	}
+	++pending;
+	sentAt.push_back(now_ms());
+
+	return true;
+}
+
+void CRedisAsync::Flush()
+{
+	if (ac != NULL && writing) redisAsyncHandleWrite(ac);
+}
+
+long CRedisAsync::getTimeLeft()
+{
+	bool connecting = !(ac->c.flags & REDIS_CONNECTED);
+	if (timeout <= 0 || (!connecting && sentAt.empty())) return -1;
+
+	long left = (connecting ? connectStart : sentAt.front()) + timeout - now_ms();
+	return left > 0 ? left : 0;
+}
+
+bool CRedisAsync::Poll(const int waitMs)
+{
+	if (ac == NULL) return false;
+
+	long left = getTimeLeft();
+	if (left == 0)
+	{
+		/* set first, the callbacks Close() runs may read it */
+		errorMsg = (ac->c.flags & REDIS_CONNECTED) ? "Command timeout" : "Connection timeout";
+		Close();
+		return false;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = ac->c.fd;
+	pfd.events = (reading ? POLLIN : 0) | (writing ? POLLOUT : 0);
+	pfd.revents = 0;
+	if (pfd.events == 0) return true;
+
+	/* wake up for the timeout, the next call reports it */
+	int wait = waitMs;
+	if (left > 0 && (wait < 0 || left < wait)) wait = (int)left;
+
+	int n = poll(&pfd,1,wait);
+	if (n < 0) return errno == EINTR;
+	if (n == 0) return true;
+
+	if (pfd.revents & (POLLIN | POLLERR | POLLHUP)) redisAsyncHandleRead(ac);
+	if (ac != NULL && (pfd.revents & POLLOUT)) redisAsyncHandleWrite(ac);
+
+	return ac != NULL;
+}
+
+bool CRedisAsync::Wait(const int timeoutMs)
+{
+	long deadline = now_ms() + timeoutMs;
+	while (pending > 0)
+	{
+		int left = timeoutMs < 0 ? -1 : (int)(deadline - now_ms());
+		if (timeoutMs >= 0 && left <= 0) return false;
+		if (!Poll(left)) return false;
+	}
+
+	return true;
+}
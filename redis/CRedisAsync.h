@@ -0,0 +1,90 @@
+#ifndef CREDISASYNC_H
+#define CREDISASYNC_H
+
+#include <hiredis/hiredis.h>
+#include <hiredis/async.h>
+
+#include <deque>
+using std::deque;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/*
+ * hiredis async context on a tiny poll() loop owned by the caller.
+ * Command() only queues, Flush() pushes queued commands to the socket
+ * without blocking, Poll() waits for the socket and runs the callbacks
+ * of the replies that arrived. Single threaded.
+ *
+ * With a timeout, Poll() gives up on a connect or a command that takes
+ * longer: it closes the connection, which fails everything pending with
+ * a NULL reply, and getError() tells which one timed out.
+ */
+class CRedisAsync
+{
+public:
+	/* reply is NULL if the connection was lost, it is freed after the call */
+	typedef void (*callback_t)(redisReply* reply,void* privdata);
+
+	CRedisAsync(const string hostname,const int port);
+	CRedisAsync();
+	~CRedisAsync();
+
+	void setIp(const string ip);
+	void setPort(const int port);
+	void setUnixSocket(const string path);
+	/* for the connect and every command, 0 waits forever */
+	void setTimeout(const int sec,const int microsec = 0);
+
+	bool Connect();
+	void Close();
+	bool isConnected();
+	string getError();
+
+	bool Command(const vector<string>& argv,callback_t callback,void* privdata);
+	void Flush();
+	/* one loop iteration, waits at most waitMs (-1: forever) */
+	bool Poll(const int waitMs);
+	/* loop until no reply is pending */
+	bool Wait(const int timeoutMs);
+	size_t getPending();
+
+private:
+	CRedisAsync(const CRedisAsync&);
+	CRedisAsync& operator=(const CRedisAsync&);
+
+	typedef struct request_t_
+	{
+		CRedisAsync* self;
+		callback_t callback;
+		void* privdata;
+	} request_t;
+
+	static void onReply(redisAsyncContext* ac,void* r,void* privdata);
+	static void addRead(void* privdata);
+	static void delRead(void* privdata);
+	static void addWrite(void* privdata);
+	static void delWrite(void* privdata);
+	static void cleanup(void* privdata);
+	/* ms until the connect or the oldest command times out, -1 if none runs */
+	long getTimeLeft();
+
+	redisAsyncContext* ac;
+	bool reading;
+	bool writing;
+	size_t pending;
+	/* ms, 0 is none */
+	long timeout;
+	long connectStart;
+	/* when each pending command was queued, redis answers in order */
+	deque<long> sentAt;
+	string errorMsg;
+	string hostname;
+	int port;
+	string unixPath;
+};
+
+#endif /*CREDISASYNC_H*/
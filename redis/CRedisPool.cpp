@@ -0,0 +1,132 @@
+#include "CRedisPool.h"
+
+#define REDIS_FREE(x) { if (x != NULL) {redisFree(x); x = NULL;} }
+
+/* idle contexts older than this are PINGed before reuse */
+#define DEFAULT_CHECK_INTERVAL 30
+
+CRedisPool::CRedisPool(const string hostname_,const int port_,const unsigned int maxIdle_)
+	: maxIdle(maxIdle_),hostname(hostname_),port(port_)
+{
+	pthread_mutex_init(&lock,NULL);
+	checkInterval = DEFAULT_CHECK_INTERVAL;
+	timeout.tv_sec = 1;
+	timeout.tv_usec = 0;
+}
+
+CRedisPool* CRedisPool::unixSocket(const string unixPath,const unsigned int maxIdle)
+{
+	CRedisPool* pool = new CRedisPool("",0,maxIdle);
+	pool->unixPath = unixPath;
+
+	return pool;
+}
+
+CRedisPool::~CRedisPool()
+{
+	for (vector<idle_t>::iterator it = idle.begin(); it != idle.end(); ++it)
+	{
+		REDIS_FREE(it->c);
+	}
+	pthread_mutex_destroy(&lock);
+}
+
+void CRedisPool::setTimeout(const int sec,const int microsec)
+{
+	timeout.tv_sec = sec;
+	timeout.tv_usec = microsec;
+}
+
+void CRedisPool::setCheckInterval(const int sec)
+{
+	checkInterval = sec;
+}
+
+redisContext* CRedisPool::connect()
+{
+	redisContext* c = NULL;
+	if (unixPath != "") c = redisConnectUnixWithTimeout(unixPath.c_str(),timeout);
+	else c = redisConnectWithTimeout(hostname.c_str(),port,timeout);
+
+	if (c == NULL || c->err)
+	{
+		pthread_mutex_lock(&lock);
+		errorMsg = c ? string(c->errstr) : string("Connection error: can't allocate redis context");
+		pthread_mutex_unlock(&lock);
+
+		REDIS_FREE(c);
+		return NULL;
+	}
+
+	/* command timeout too, a dead server must not hang a scan */
+	redisSetTimeout(c,timeout);
+	if (unixPath == "") redisEnableKeepAlive(c);
+
+	return c;
+}
+
+bool CRedisPool::ping(redisContext* c)
+{
+	redisReply* reply = (redisReply*)redisCommand(c,"PING");
+	if (reply == NULL) return false;
+
+	bool ok = (reply->type == REDIS_REPLY_STATUS);
+	freeReplyObject(reply);
+	return ok;
+}
+
+redisContext* CRedisPool::Get()
+{
+	for (;;)
+	{
+		pthread_mutex_lock(&lock);
+		if (idle.empty())
+		{
+			pthread_mutex_unlock(&lock);
+			break;
+		}
+		idle_t entry = idle.back();
+		idle.pop_back();
+		pthread_mutex_unlock(&lock);
+
+		if (entry.c->err == 0 &&
+			(time(NULL) - entry.lastUsed < checkInterval || ping(entry.c)))
+		{
+			return entry.c;
+		}
+		REDIS_FREE(entry.c);
+	}
+
+	return connect();
+}
+
+void CRedisPool::Put(redisContext* c)
+{
+	if (c == NULL) return;
+	if (c->err)
+	{
+		REDIS_FREE(c);
+		return;
+	}
+
+	idle_t entry = {c,time(NULL)};
+
+	pthread_mutex_lock(&lock);
+	if (idle.size() < maxIdle)
+	{
+		idle.push_back(entry);
+		c = NULL;
+	}
+	pthread_mutex_unlock(&lock);
+
+	REDIS_FREE(c);
+}
+
+string CRedisPool::getError()
+{
+	pthread_mutex_lock(&lock);
+	string ret = errorMsg;
+	pthread_mutex_unlock(&lock);
+
+	return ret;
+}
@@ -0,0 +1,61 @@
+#ifndef CREDISPOOL_H
+#define CREDISPOOL_H
+
+#include <hiredis/hiredis.h>
+
+#include <pthread.h>
+#include <time.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/*
+ * thread safe pool of connected redis contexts.
+ * Get() hands out an idle context (or connects a new one), Put() gives it
+ * back. Idle contexts are health checked with PING before reuse and
+ * broken ones are dropped, so reconnects happen lazily.
+ */
+class CRedisPool
+{
+public:
+	CRedisPool(const string hostname,const int port,const unsigned int maxIdle = 8);
+	/* a pool of unix socket connections, delete it when done */
+	static CRedisPool* unixSocket(const string unixPath,const unsigned int maxIdle = 8);
+	~CRedisPool();
+
+	void setTimeout(const int sec,const int microsec = 0);
+	void setCheckInterval(const int sec);
+
+	redisContext* Get();
+	void Put(redisContext* c);
+	string getError();
+
+private:
+	CRedisPool(const CRedisPool&);
+	CRedisPool& operator=(const CRedisPool&);
+
+	typedef struct idle_t_
+	{
+		redisContext* c;
+		time_t lastUsed;
+	} idle_t;
+
+	redisContext* connect();
+	bool ping(redisContext* c);
+
+	pthread_mutex_t lock;
+	vector<idle_t> idle;
+	unsigned int maxIdle;
+	int checkInterval;
+
+	string hostname;
+	int port;
+	string unixPath;
+	struct timeval timeout;
+	string errorMsg;
+};
+
+#endif /*CREDISPOOL_H*/
@@ -32,6 +32,19 @@ int main(int argc,char* argv[])
 	// get
 	cout << myRedis.Get("foo") << endl;
 
+	// mget
+	vector<string> keys;
+	keys.push_back("foo");
+	keys.push_back("not_exist");
+	vector<string> values;
+	myRedis.setBatchSize(1);
+	if (false == myRedis.MGet(keys,values))
+	{
+		cerr << myRedis.getError() << endl;
+		return -1;
+	}
+	cout << values[0] << "|" << values[1] << endl;
+
 	// delete
 	if (false == myRedis.Delete("foo"))
 	{
@@ -42,5 +55,21 @@ int main(int argc,char* argv[])
 	// close
 	myRedis.Close();
 
+	// pooled connection, Close() gives the context back to the pool
+	CRedisPool myPool("127.0.0.1",6379);
+	myPool.setTimeout(CONNECT_TIMEOUT);
+	myRedis.setPool(&myPool);
+	for (int i = 0; i < 2; ++i)
+	{
+		if (false == myRedis.Connect())
+		{
+			cerr << myRedis.getError() << endl;
+			return -1;
+		}
+		cout << myRedis.Get("foo") << endl;
+		myRedis.Close();
+	}
+	myRedis.setPool(NULL);
+
 	return 0;
 }
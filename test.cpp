@@ -1,24 +1,229 @@
 #include "CAntiSpamMail.h"
+#include "comm/CMailBox.h"
+#include "CScanEngine.h"
+#include "CAsyncScanner.h"
+#include "comm/CTokenFile.h"
+#include "comm/CMemTokenStore.h"
 
 FastString get_file_content(const string filename);
 
-const double SPAM_CUTOFF = 0.90;
-
 //git test
 
+/* tokenizer switches, the same for every scanner */
+static bool fastLatin = false;
+static int normFlags = 0;
+
+static void print_result(const double spamicity,const string& name)
+{
+	cout << ((spamicity > SPAM_CUTOFF) ? "SPAM" : "HAM" ) << " " << spamicity << " " << name << endl;
+}
+
+/* same on a CScanEngine, results are printed in mailbox order */
+static int test_parallel(CMailBox& mailbox,const int threads,CTokenCache* cache,
+		CKnownTokens* known,CTokenStore* store)
+{
+	CScanEngine engine(threads);
+	engine.setTokenCache(cache);
+	engine.setKnownTokens(known);
+	engine.setTokenStore(store);
+	engine.setFastLatin(fastLatin);
+	engine.setNormalize(normFlags);
+	if (false == engine.Start())
+	{
+		cerr << "can't start scan threads" << endl;
+		return -1;
+	}
+
+	const size_t MAX_INFLIGHT = threads * 64;
+	deque<pair<string,CScanFuture> > inflight;
+	string name;
+	string data;
+	while (mailbox.Next(name,data))
+	{
+		inflight.push_back(make_pair(name,engine.Submit(data)));
+		while (inflight.size() > MAX_INFLIGHT)
+		{
+			print_result(inflight.front().second.get(),inflight.front().first);
+			inflight.pop_front();
+		}
+	}
+
+	for (; !inflight.empty(); inflight.pop_front())
+	{
+		print_result(inflight.front().second.get(),inflight.front().first);
+	}
+	engine.Stop();
+
+	return 0;
+}
+
+/* same on one thread with overlapping redis lookups, results are
+ * printed as they finish */
+static int test_async(CMailBox& mailbox,CTokenCache* cache,CKnownTokens* known)
+{
+	CAsyncScanner scanner;
+	scanner.setTokenCache(cache);
+	scanner.setKnownTokens(known);
+	scanner.setFastLatin(fastLatin);
+	scanner.setNormalize(normFlags);
+	if (false == scanner.Start())
+	{
+		cerr << scanner.getError() << endl;
+		return -1;
+	}
+
+	const size_t MAX_INFLIGHT = 256;
+	string name;
+	string data;
+	void* tag = NULL;
+	double spamicity = 0.0;
+	while (mailbox.Next(name,data))
+	{
+		FastString mail(data.data(),data.size());
+		string* owned = new string(name);
+		if (false == scanner.Submit(mail,owned))
+		{
+			cerr << scanner.getError() << endl;
+			delete owned;
+			continue;
+		}
+
+		/* take what is done, block only when too much is in flight */
+		while (scanner.Next(tag,spamicity,scanner.getInflight() > MAX_INFLIGHT ? -1 : 0))
+		{
+			print_result(spamicity,*(string*)tag);
+			delete (string*)tag;
+		}
+	}
+
+	while (scanner.Next(tag,spamicity))
+	{
+		print_result(spamicity,*(string*)tag);
+		delete (string*)tag;
+	}
+
+	return 0;
+}
+
+/* score every message of a directory, Maildir or mbox with one CAntiSpamMail */
+static int test_batch(const string path,const int threads,const bool async,CTokenStore* store)
+{
+	CMailBox mailbox;
+	if (false == mailbox.Open(path))
+	{
+		cerr << mailbox.getError() << endl;
+		return -1;
+	}
+
+	/* the tokens every message has are fetched from redis once */
+	CTokenCache tokenCache;
+	CTokenCache* cache = (store == NULL) ? &tokenCache : NULL;
+
+	/* never seen tokens aren't looked up at all */
+	CKnownTokens knownTokens;
+	CKnownTokens* known = NULL;
+	if (store == NULL)
+	{
+		if (knownTokens.Load()) known = &knownTokens;
+		else cerr << "no bloom filter: " << knownTokens.getError() << endl;
+	}
+
+	int ret = 0;
+	if (async) ret = test_async(mailbox,cache,known);
+	else if (threads > 1) ret = test_parallel(mailbox,threads,cache,known,store);
+	else
+	{
+		CAntiSpamMail myAntispam;
+		myAntispam.setTokenCache(cache);
+		myAntispam.setKnownTokens(known);
+		myAntispam.setTokenStore(store);
+		myAntispam.setFastLatin(fastLatin);
+		myAntispam.setNormalize(normFlags);
+		string name;
+		string data;
+		while (mailbox.Next(name,data))
+		{
+			print_result(myAntispam.getSpamicity(FastString(data.data(),data.size())),name);
+		}
+	}
+
+	if (cache != NULL) cerr << "token cache: " << cache->getHits() << " hits, " << cache->getMisses() << " misses" << endl;
+
+	return ret;
+}
+
+static void usage(const char* prog)
+{
+	cerr << "Usage: " << prog << " [-f|-m token_file] [-L] [-Z norm] <email>" << endl;
+	cerr << "       " << prog << " [-f|-m token_file] [-L] [-Z norm] [-j threads] -b <dir|Maildir|mbox>" << endl;
+	cerr << "       " << prog << " [-L] [-Z norm] -a -b <dir|Maildir|mbox>" << endl;
+	cerr << "  -f  score from an exportdb file, mapped" << endl;
+	cerr << "  -m  same, loaded into memory first" << endl;
+	cerr << "  -L  split latin text without scws, for a store fed with feed -L" << endl;
+	cerr << "  -Z  normalize (case,width,digits) as the store was fed with feed -Z" << endl;
+	exit(-1);
+}
+
 int main(int argc,char* argv[])
 {
-	if (argc != 2)
+	string batchPath = "";
+	string tokenPath = "";
+	int threads = 1;
+	bool async = false;
+	bool inMemory = false;
+
+	int opt;
+	while ((opt = getopt(argc,argv,"b:j:af:m:LZ:")) != -1)
 	{
-		cerr << "Usage: " << argv[0] << " <email>" << endl;		
+		switch (opt)
+		{
+			case 'b': batchPath = optarg; break;
+			case 'j': threads = atoi(optarg); break;
+			case 'a': async = true; break;
+			case 'f': tokenPath = optarg; break;
+			case 'm': tokenPath = optarg; inMemory = true; break;
+			case 'L': fastLatin = true; break;
+			case 'Z': if (false == parse_normalize(optarg,normFlags)) usage(argv[0]); break;
+			default: usage(argv[0]);
+		}
+	}
+	/* the async scanner only talks to redis */
+	if (async && tokenPath != "") usage(argv[0]);
+	if ((batchPath == "" && optind != argc - 1) || (batchPath != "" && optind != argc)) usage(argv[0]);
+
+	CTokenFile tokenFile;
+	if (tokenPath != "" && false == tokenFile.Open(tokenPath))
+	{
+		cerr << tokenFile.getError() << endl;
 		exit(-1);
 	}
+	CTokenStore* store = tokenFile.isOpen() ? &tokenFile : NULL;
+
+	/* no redis, no page faults: a baseline for the rest of the pipeline */
+	CMemTokenStore memStore;
+	if (inMemory)
+	{
+		vector<string> tokens;
+		vector<b_word_t> words;
+		tokenFile.getAll(tokens,words);
+		memStore.Load(tokens,words,tokenFile.isHashed());
+		tokenFile.Close();
+		store = &memStore;
+	}
+
+	if (batchPath != "")
+	{
+		exit(test_batch(batchPath,threads,async,store));
+	}
 
 	/* get email data */
-	FastString email_data = get_file_content(argv[1]);
+	FastString email_data = get_file_content(argv[optind]);
 
 	/* check */
 	CAntiSpamMail  myAntispam;
+	myAntispam.setTokenStore(store);
+	myAntispam.setFastLatin(fastLatin);
+	myAntispam.setNormalize(normFlags);
 	double spamicity = myAntispam.getSpamicity(email_data);
 	cout << ((spamicity > SPAM_CUTOFF) ? "SPAM" : "HAM" ) << " " << spamicity << endl;
 
@@ -1,17 +1,5 @@
 #!/bin/bash
 
-[ $# -ne 1 ] && { echo "Usage: $0 <dir>"; exit; }
+[ $# -ne 1 ] && { echo "Usage: $0 <dir|Maildir|mbox>"; exit; }
 
-OLDIFS=$IFS
-IFS=$'\n'
-
-
-cd $1
-for file in `ls`
-do
-	#echo "testing $file ..."
-	/home/dep/AntispamServer/test  "$file"
-done
-
-cd ..
-IFS=$OLDIFS
+/home/dep/AntispamServer/test -b "$1"